@@ -0,0 +1,101 @@
+// Extended-range float for deep zoom deltas: x = m * 2^e, m in [0.5, 1) or 0.
+// Complex values share one exponent between both parts so a whole delta
+// moves through the vector units as a single vec2.
+
+const int FE_ZERO_EXPONENT = -0x20000000;
+
+struct floatexp
+{
+    float m;
+    int e;
+};
+
+struct cfloatexp
+{
+    vec2 m;
+    int e;
+};
+
+floatexp fe_normalize(float m, int e)
+{
+    int k;
+    float f = frexp(m, k);
+    return floatexp(f, m == 0.0 ? FE_ZERO_EXPONENT : e + k);
+}
+
+floatexp fe_from_float(float x)
+{
+    return fe_normalize(x, 0);
+}
+
+float fe_to_float(floatexp a)
+{
+    return ldexp(a.m, clamp(a.e, -150, 128));
+}
+
+floatexp fe_mul(floatexp a, floatexp b)
+{
+    return fe_normalize(a.m * b.m, a.e + b.e);
+}
+
+floatexp fe_add(floatexp a, floatexp b)
+{
+    int diff = a.e - b.e;
+    if (diff > 25) return a;
+    if (diff < -25) return b;
+    if (diff >= 0) return fe_normalize(a.m + ldexp(b.m, -diff), a.e);
+    return fe_normalize(ldexp(a.m, diff) + b.m, b.e);
+}
+
+cfloatexp cfe_normalize(vec2 m, int e)
+{
+    // Normalize on the larger component; the other keeps relative precision
+    int k;
+    frexp(max(abs(m.x), abs(m.y)), k);
+    bool zero = m.x == 0.0 && m.y == 0.0;
+    return cfloatexp(zero ? vec2(0.0) : ldexp(m, ivec2(-k)), zero ? FE_ZERO_EXPONENT : e + k);
+}
+
+cfloatexp cfe_from_vec2(vec2 z)
+{
+    return cfe_normalize(z, 0);
+}
+
+vec2 cfe_to_vec2(cfloatexp a)
+{
+    return ldexp(a.m, ivec2(clamp(a.e, -150, 128)));
+}
+
+cfloatexp cfe_add(cfloatexp a, cfloatexp b)
+{
+    int diff = a.e - b.e;
+    if (diff > 25) return a;
+    if (diff < -25) return b;
+    if (diff >= 0) return cfe_normalize(a.m + ldexp(b.m, ivec2(-diff)), a.e);
+    return cfe_normalize(ldexp(a.m, ivec2(diff)) + b.m, b.e);
+}
+
+cfloatexp cfe_mul(cfloatexp a, cfloatexp b)
+{
+    vec2 m = vec2(a.m.x * b.m.x - a.m.y * b.m.y, a.m.x * b.m.y + a.m.y * b.m.x);
+    return cfe_normalize(m, a.e + b.e);
+}
+
+cfloatexp cfe_sqr(cfloatexp a)
+{
+    vec2 m = vec2(a.m.x * a.m.x - a.m.y * a.m.y, 2.0 * a.m.x * a.m.y);
+    return cfe_normalize(m, 2 * a.e);
+}
+
+// Complex times a plain (in-range) vec2, e.g. 2 * Z_n from a reference orbit
+cfloatexp cfe_mul_vec2(cfloatexp a, vec2 b)
+{
+    vec2 m = vec2(a.m.x * b.x - a.m.y * b.y, a.m.x * b.y + a.m.y * b.x);
+    return cfe_normalize(m, a.e);
+}
+
+// |a|^2 as a floatexp
+floatexp cfe_norm(cfloatexp a)
+{
+    return fe_normalize(dot(a.m, a.m), 2 * a.e);
+}
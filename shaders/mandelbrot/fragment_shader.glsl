@@ -1,22 +1,63 @@
-#version 460 core
+#version 450 core
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out int FragIterations; // Only read back by offscreen renders
+uniform vec2 u_origin; // Window position of the render rect
 uniform vec2 u_resolution;
 uniform vec2 u_center;
 uniform float u_zoom;
+uniform int u_max_iterations;
+uniform bool u_cardioid_check;    // see src/interior_checks.h
+uniform bool u_periodicity_check;
+uniform bool u_derivative_check;
 
-const int MAX_ITERATIONS = 10000;
+const float DERIVATIVE_EPSILON = 1e-12;
 
-precise int renderMandelbrot()
+bool inMainCardioidOrBulb(vec2 c)
 {
-    vec2 uv = (gl_FragCoord.xy / u_resolution - 0.5) * u_zoom + u_center;
+    float x = c.x - 0.25;
+    float yy = c.y * c.y;
+    float q = x * x + yy;
+    if (q * (q + x) < 0.25 * yy)
+        return true;
+    return (c.x + 1.0) * (c.x + 1.0) + yy < 0.0625;
+}
+
+int renderMandelbrot()
+{
+    vec2 uv = ((gl_FragCoord.xy - u_origin) / u_resolution - 0.5) * u_zoom + u_center;
     vec2 c = uv;
-    vec2 z = vec2(0.0);
+    if (u_cardioid_check && inMainCardioidOrBulb(c))
+        return u_max_iterations;
+
+    precise vec2 z = vec2(0.0); // no fused multiply-adds, like the CPU loops
+    vec2 saved = vec2(0.0);
+    vec2 dz = vec2(1.0, 0.0);
+    int check_at = 1;
     int i;
-    for (i = 0; i < MAX_ITERATIONS; i++)
+    for (i = 0; i < u_max_iterations; i++)
     {
         z = vec2(z.x * z.x - z.y * z.y + c.x, 2.0 * z.x * z.y + c.y);
         if (z.x*z.x + z.y*z.y > 4.0) break;
+
+        // Brent: an orbit that returns exactly to a saved z never escapes
+        if (u_periodicity_check)
+        {
+            if (z == saved)
+                return u_max_iterations;
+            if (i + 1 == check_at)
+            {
+                saved = z;
+                check_at *= 2;
+            }
+        }
+        // dz_(n+1)/dz_1 shrinking to nothing means an attracting cycle
+        if (u_derivative_check)
+        {
+            dz = 2.0 * vec2(z.x * dz.x - z.y * dz.y, z.x * dz.y + z.y * dz.x);
+            if (dot(dz, dz) < DERIVATIVE_EPSILON)
+                return u_max_iterations;
+        }
     }
     return i;
 }
@@ -24,7 +65,7 @@ precise int renderMandelbrot()
 void main()
 {
     int iterations = renderMandelbrot();
-    float t = float(iterations) / float(MAX_ITERATIONS);
+    float t = float(iterations) / float(u_max_iterations);
     FragColor = vec4(vec3(t), 1.0);
+    FragIterations = iterations;
 }
-
@@ -0,0 +1,61 @@
+#version 450 core
+
+// Perturbation for views past what float can address, as in
+// src/perturbation.h: the reference orbit Z_n is iterated on the CPU and each
+// pixel only follows its delta dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc, kept as a
+// cfloatexp so it doesn't underflow. Deltas are rebased onto the start of the
+// reference when |z| < |dz| or the reference runs out; there's no glitch pass.
+
+#include "../common/floatexp.glsl"
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out int FragIterations; // Only read back by offscreen renders
+layout(std430, binding = 0) readonly buffer ReferenceOrbit
+{
+    vec2 reference_orbit[]; // Z_n rounded to float; |Z_n| <= 2 until the last
+};
+uniform vec2 u_origin; // Window position of the render rect
+uniform vec2 u_resolution;
+uniform float u_zoom_mantissa; // zoom = mantissa * 2^exponent
+uniform int u_zoom_exponent;
+uniform vec2 u_reference_offset_mantissa; // reference minus view center
+uniform int u_reference_offset_exponent;
+uniform int u_reference_length;
+uniform int u_max_iterations;
+
+int renderPerturbation()
+{
+    vec2 uv = (gl_FragCoord.xy - u_origin) / u_resolution - 0.5;
+    cfloatexp offset = cfloatexp(-u_reference_offset_mantissa, u_reference_offset_exponent);
+    cfloatexp dc = cfe_add(cfe_normalize(uv * u_zoom_mantissa, u_zoom_exponent), offset);
+
+    cfloatexp dz = cfloatexp(vec2(0.0), FE_ZERO_EXPONENT);
+    int last = u_reference_length - 1;
+    int n = 0;
+    int i;
+    for (i = 0; i < u_max_iterations; i++)
+    {
+        // dz (dz + 2 Z_n) + dc, in the order the CPU loop uses
+        dz = cfe_add(cfe_mul(dz, cfe_add(dz, cfe_from_vec2(2.0 * reference_orbit[n]))), dc);
+        n++;
+
+        vec2 z = reference_orbit[n] + cfe_to_vec2(dz);
+        float norm = dot(z, z);
+        if (norm > 4.0) break;
+
+        if (norm < fe_to_float(cfe_norm(dz)) || n == last)
+        {
+            dz = cfe_from_vec2(z);
+            n = 0;
+        }
+    }
+    return i;
+}
+
+void main()
+{
+    int iterations = renderPerturbation();
+    float t = float(iterations) / float(u_max_iterations);
+    FragColor = vec4(vec3(t), 1.0);
+    FragIterations = iterations;
+}
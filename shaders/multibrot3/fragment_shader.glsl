@@ -0,0 +1,47 @@
+#version 450 core
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out int FragIterations; // Only read back by offscreen renders
+uniform vec2 u_origin; // Window position of the render rect
+uniform vec2 u_resolution;
+uniform vec2 u_center;
+uniform float u_zoom;
+uniform int u_max_iterations;
+uniform bool u_periodicity_check; // see src/interior_checks.h
+
+int renderMultibrot3()
+{
+    vec2 uv = ((gl_FragCoord.xy - u_origin) / u_resolution - 0.5) * u_zoom + u_center;
+    vec2 c = uv;
+    precise vec2 z = vec2(0.0); // no fused multiply-adds, like the CPU loops
+    vec2 saved = vec2(0.0);
+    int check_at = 1;
+    int i;
+    for (i = 0; i < u_max_iterations; i++)
+    {
+        float xx = z.x * z.x, yy = z.y * z.y;
+        z = vec2(z.x * (xx - 3.0 * yy) + c.x, z.y * (3.0 * xx - yy) + c.y);
+        if (z.x*z.x + z.y*z.y > 4.0) break;
+
+        // Brent: an orbit that returns exactly to a saved z never escapes
+        if (u_periodicity_check)
+        {
+            if (z == saved)
+                return u_max_iterations;
+            if (i + 1 == check_at)
+            {
+                saved = z;
+                check_at *= 2;
+            }
+        }
+    }
+    return i;
+}
+
+void main()
+{
+    int iterations = renderMultibrot3();
+    float t = float(iterations) / float(u_max_iterations);
+    FragColor = vec4(vec3(t), 1.0);
+    FragIterations = iterations;
+}
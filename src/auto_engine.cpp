@@ -0,0 +1,110 @@
+#include "auto_engine.h"
+
+#include <chrono>
+
+AutoEngine::AutoEngine(bool use_gpu, std::shared_ptr<TileScheduler> scheduler)
+    : scheduler(scheduler)
+{
+    planner.gpu_available = use_gpu;
+}
+
+bool AutoEngine::render(const View& view, IterationBuffer& buffer)
+{
+    PrecisionTier tier = planner.plan(view);
+    auto start = std::chrono::steady_clock::now();
+    bool rendered = renderWith(tier, view, buffer);
+    if (!rendered && !cancelled() && tier != PrecisionTier::CPU_DOUBLE_DOUBLE)
+    {
+        // Deepest CPU type as a last resort
+        tier = PrecisionTier::CPU_DOUBLE_DOUBLE;
+        rendered = renderWith(tier, view, buffer);
+    }
+    if (!rendered)
+        return false;
+
+    last_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    last_tier = tier;
+    planner.recordFrame(tier, view, last_seconds);
+    return true;
+}
+
+void AutoEngine::setCancelFlag(const std::atomic<bool>* flag)
+{
+    Engine::setCancelFlag(flag);
+    if (gl_engine)
+        gl_engine->setCancelFlag(flag);
+    if (cpu_engine)
+        cpu_engine->setCancelFlag(flag);
+    if (perturbation_engine)
+        perturbation_engine->setCancelFlag(flag);
+}
+
+bool AutoEngine::draw(const View& view, int x, int y)
+{
+    // An earlier draw counts even if this frame leaves the GPU
+    View timed_view;
+    double seconds;
+    if (gl_engine && gl_engine->finishedDraw(timed_view, seconds))
+    {
+        planner.recordFrame(PrecisionTier::GPU_FLOAT, timed_view, seconds);
+        if (seconds > 0.0)
+            draw_throughput = timed_view.width * (double)timed_view.height / seconds;
+    }
+
+    if (planner.plan(view) != PrecisionTier::GPU_FLOAT)
+        return false;
+    if (!gl_engine)
+        gl_engine.reset(new GlEngine(shader_directory));
+    gl_engine->interior = interior;
+    gl_engine->draw(view, x, y);
+    last_tier = PrecisionTier::GPU_FLOAT;
+    return true;
+}
+
+bool AutoEngine::renderWith(PrecisionTier tier, const View& view, IterationBuffer& buffer)
+{
+    switch (tier)
+    {
+        case PrecisionTier::GPU_FLOAT:
+            if (!gl_engine)
+                gl_engine.reset(new GlEngine(shader_directory));
+            gl_engine->interior = interior;
+            return gl_engine->render(view, buffer);
+        case PrecisionTier::PERTURBATION:
+            if (!perturbation_engine)
+            {
+                perturbation_engine.reset(new PerturbationEngine(scheduler));
+                perturbation_engine->setCancelFlag(cancel_flag);
+            }
+            perturbation_engine->references = references;
+            return perturbation_engine->render(view, buffer);
+        default:
+            break;
+    }
+
+    if (!cpu_engine)
+    {
+        cpu_engine.reset(new CpuEngine(scheduler));
+        cpu_engine->setCancelFlag(cancel_flag);
+    }
+    cpu_engine->interior = interior;
+    cpu_engine->focus_x = focus_x;
+    cpu_engine->focus_y = focus_y;
+    cpu_engine->auto_precision = false;
+    switch (tier)
+    {
+        case PrecisionTier::CPU_FLOAT:
+            cpu_engine->manual_precision = CpuPrecision::FLOAT;
+            break;
+        case PrecisionTier::CPU_FIXED128:
+            cpu_engine->manual_precision = CpuPrecision::FIXED128;
+            break;
+        case PrecisionTier::CPU_DOUBLE_DOUBLE:
+            cpu_engine->manual_precision = CpuPrecision::DOUBLE_DOUBLE;
+            break;
+        default:
+            cpu_engine->manual_precision = CpuPrecision::DOUBLE;
+            break;
+    }
+    return cpu_engine->render(view, buffer);
+}
@@ -0,0 +1,58 @@
+#ifndef AUTO_ENGINE_H
+#define AUTO_ENGINE_H
+
+#include <memory>
+#include <string>
+
+#include "cpu_engine.h"
+#include "engine.h"
+#include "gl_engine.h"
+#include "perturbation_engine.h"
+#include "precision_planner.h"
+
+// Hands each frame to whichever engine and number type the planner expects
+// to be fastest while still resolving the view, and reports back how long
+// it took so the planner's costs follow this machine
+class AutoEngine : public Engine
+{
+public:
+    PrecisionPlanner planner;
+    InteriorChecks interior;
+    // Passed on to the CPU engine
+    double focus_x = -1.0, focus_y = -1.0;
+    // Where the GPU engine looks for its shaders
+    std::string shader_directory = "../shaders";
+    // Handed to the perturbation engine
+    std::shared_ptr<ReferenceCache> references;
+
+    // Without the GPU no GL context is needed
+    explicit AutoEngine(bool use_gpu = true, std::shared_ptr<TileScheduler> scheduler = nullptr);
+
+    EngineType type() const override { return EngineType::AUTO; }
+    bool render(const View& view, IterationBuffer& buffer) override;
+    void setCancelFlag(const std::atomic<bool>* flag) override;
+
+    // Draws straight into the bound framebuffer when the planner picks the
+    // GPU for `view`, like GlEngine::draw(); returns false otherwise, and
+    // the frame should go through render(). Draws are timed on the GPU and
+    // fed to the planner as their timer queries come back.
+    bool draw(const View& view, int x, int y);
+
+    PrecisionTier lastTier() const { return last_tier; }
+    double lastSeconds() const { return last_seconds; }
+    // Pixels per second of the newest timed draw(), 0 before there is one
+    double drawThroughput() const { return draw_throughput; }
+
+private:
+    bool renderWith(PrecisionTier tier, const View& view, IterationBuffer& buffer);
+
+    std::shared_ptr<TileScheduler> scheduler;
+    std::unique_ptr<GlEngine> gl_engine;
+    std::unique_ptr<CpuEngine> cpu_engine;
+    std::unique_ptr<PerturbationEngine> perturbation_engine;
+    PrecisionTier last_tier = PrecisionTier::CPU_DOUBLE;
+    double last_seconds = 0.0;
+    double draw_throughput = 0.0;
+};
+
+#endif
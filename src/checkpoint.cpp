@@ -0,0 +1,373 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+#include "cpu_engine.h"
+#include "perturbation_engine.h"
+#include "precision_planner.h"
+
+namespace
+{
+
+const char MAGIC[8] = { 'L', 'Z', 'C', 'K', 'P', 'T', '1', '\n' };
+
+// Record types
+const uint32_t JOB = 'J';       // band rows, then describeRenderJob() text; always first
+const uint32_t REFERENCE = 'R'; // primary reference orbit
+const uint32_t BAND = 'B';      // first row, rows, width, then the counts
+
+uint64_t checksum(uint32_t type, const std::vector<uint8_t>& payload)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const uint8_t* bytes, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    };
+    uint64_t size = payload.size();
+    mix(reinterpret_cast<const uint8_t*>(&type), sizeof(type));
+    mix(reinterpret_cast<const uint8_t*>(&size), sizeof(size));
+    mix(payload.data(), payload.size());
+    return hash;
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& payload, const T& value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+void putArray(std::vector<uint8_t>& payload, const std::vector<T>& values)
+{
+    put(payload, (uint64_t)values.size());
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+    payload.insert(payload.end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+// Reads back what put() wrote, failing rather than running off the end
+struct PayloadReader
+{
+    const std::vector<uint8_t>& payload;
+    size_t position = 0;
+
+    explicit PayloadReader(const std::vector<uint8_t>& payload) : payload(payload) {}
+
+    bool read(void* value, size_t size)
+    {
+        if (payload.size() - position < size)
+            return false;
+        std::memcpy(value, payload.data() + position, size);
+        position += size;
+        return true;
+    }
+
+    template <typename T>
+    bool get(T& value) { return read(&value, sizeof(T)); }
+
+    template <typename T>
+    bool getArray(std::vector<T>& values)
+    {
+        uint64_t count;
+        if (!get(count) || count > (payload.size() - position) / sizeof(T))
+            return false;
+        values.resize(count);
+        return read(values.data(), count * sizeof(T));
+    }
+};
+
+bool writeRecord(FILE* file, uint32_t type, const std::vector<uint8_t>& payload)
+{
+    uint64_t size = payload.size(), sum = checksum(type, payload);
+    return std::fwrite(&type, sizeof(type), 1, file) == 1 && std::fwrite(&size, sizeof(size), 1, file) == 1
+        && std::fwrite(payload.data(), 1, payload.size(), file) == payload.size()
+        && std::fwrite(&sum, sizeof(sum), 1, file) == 1 && std::fflush(file) == 0;
+}
+
+bool readRecord(FILE* file, uint32_t& type, std::vector<uint8_t>& payload)
+{
+    uint64_t size, sum;
+    if (std::fread(&type, sizeof(type), 1, file) != 1 || std::fread(&size, sizeof(size), 1, file) != 1)
+        return false;
+    // A torn length could ask for anything; the file has to hold it
+    long start = std::ftell(file);
+    if (std::fseek(file, 0, SEEK_END) != 0)
+        return false;
+    long end = std::ftell(file);
+    if (start < 0 || end < start || size > (uint64_t)(end - start))
+        return false;
+    std::fseek(file, start, SEEK_SET);
+    payload.resize(size);
+    return std::fread(payload.data(), 1, size, file) == size && std::fread(&sum, sizeof(sum), 1, file) == 1
+        && sum == checksum(type, payload);
+}
+
+// Whether the file ends inside the record at `start`, as it does when a run
+// died while writing that record
+bool endsInRecord(FILE* file, long start)
+{
+    uint32_t type;
+    uint64_t size;
+    if (std::fseek(file, 0, SEEK_END) != 0)
+        return false;
+    long end = std::ftell(file);
+    std::fseek(file, start, SEEK_SET);
+    if (std::fread(&type, sizeof(type), 1, file) != 1 || std::fread(&size, sizeof(size), 1, file) != 1)
+        return true;
+    long payload = std::ftell(file);
+    return end < payload || size > (uint64_t)(end - payload) || (uint64_t)(end - payload) - size < sizeof(uint64_t);
+}
+
+void putFloatExp(std::vector<uint8_t>& payload, const floatexp& value)
+{
+    put(payload, (double)value.mantissa);
+    put(payload, (int32_t)value.exponent);
+}
+
+bool getFloatExp(PayloadReader& reader, floatexp& value)
+{
+    double mantissa;
+    int32_t exponent;
+    if (!reader.get(mantissa) || !reader.get(exponent))
+        return false;
+    value.mantissa = mantissa;
+    value.exponent = exponent;
+    return true;
+}
+
+std::vector<uint8_t> referencePayload(const PrimaryReference& reference)
+{
+    std::vector<uint8_t> payload;
+    putFloatExp(payload, reference.offset_x);
+    putFloatExp(payload, reference.offset_y);
+    put(payload, (int32_t)reference.period);
+    putArray(payload, reference.orbit->re);
+    putArray(payload, reference.orbit->im);
+    putArray(payload, reference.orbit->glitch_bound);
+    return payload;
+}
+
+bool readReference(const std::vector<uint8_t>& payload, PrimaryReference& reference)
+{
+    PayloadReader reader(payload);
+    std::shared_ptr<ReferenceOrbit> orbit = std::make_shared<ReferenceOrbit>();
+    int32_t period;
+    if (!getFloatExp(reader, reference.offset_x) || !getFloatExp(reader, reference.offset_y) || !reader.get(period)
+        || !reader.getArray(orbit->re) || !reader.getArray(orbit->im) || !reader.getArray(orbit->glitch_bound))
+        return false;
+    if (orbit->re.empty() || orbit->im.size() != orbit->re.size() || orbit->glitch_bound.size() != orbit->re.size())
+        return false;
+    reference.period = period;
+    reference.orbit = orbit;
+    return true;
+}
+
+}
+
+bool renderCheckpointed(const RenderJob& job, IterationBuffer& buffer, const CheckpointOptions& options,
+                        CheckpointStats* stats, std::string& error)
+{
+    const View& view = job.view;
+    EngineType engine_type = job.engine;
+    if (engine_type == EngineType::AUTO)
+    {
+        PrecisionPlanner planner;
+        planner.gpu_available = false;
+        bool deep = planner.plan(view) == PrecisionTier::PERTURBATION;
+        engine_type = deep ? EngineType::PERTURBATION : EngineType::CPU;
+    }
+    if (engine_type != EngineType::CPU && engine_type != EngineType::PERTURBATION)
+    {
+        error = "checkpoints need the cpu, perturbation or auto engine";
+        return false;
+    }
+
+    CheckpointStats local_stats;
+    CheckpointStats& result = stats ? *stats : local_stats;
+    result = CheckpointStats();
+    std::string description = describeRenderJob(job);
+    buffer.resize(view.width, view.height);
+
+    // Read back whatever an earlier run of the same job saved
+    int band_rows = std::max(1, options.band_rows);
+    std::vector<bool> band_done;
+    PrimaryReference reference;
+    long valid_end = 0;
+    FILE* file = std::fopen(options.path.c_str(), "rb");
+    if (file)
+    {
+        char magic[sizeof(MAGIC)];
+        uint32_t type;
+        std::vector<uint8_t> payload;
+        // A run that died creating the log leaves a prefix of the magic and
+        // the JOB record; that's as good as no log
+        size_t got = std::fread(magic, 1, sizeof(magic), file);
+        bool empty = got == 0 || (std::memcmp(magic, MAGIC, got) == 0
+                                  && (got < sizeof(MAGIC) || endsInRecord(file, sizeof(MAGIC))));
+        std::fseek(file, sizeof(MAGIC), SEEK_SET);
+        if (!empty)
+        {
+            int32_t saved_band_rows = 0;
+            PayloadReader reader(payload);
+            bool valid = std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && readRecord(file, type, payload)
+                && type == JOB && reader.get(saved_band_rows) && saved_band_rows > 0;
+            if (!valid)
+            {
+                std::fclose(file);
+                error = options.path + " isn't a checkpoint; not overwriting it";
+                return false;
+            }
+            if (std::string(payload.begin() + reader.position, payload.end()) != description)
+            {
+                std::fclose(file);
+                error = options.path + " is a checkpoint of a different job";
+                return false;
+            }
+            band_rows = saved_band_rows;
+            band_done.assign((view.height + band_rows - 1) / band_rows, false);
+            valid_end = std::ftell(file);
+
+            while (readRecord(file, type, payload))
+            {
+                PayloadReader reader(payload);
+                if (type == REFERENCE)
+                {
+                    if (!readReference(payload, reference))
+                        break;
+                    result.resumed_reference = true;
+                }
+                else if (type == BAND)
+                {
+                    int32_t first_row, rows, width;
+                    if (!reader.get(first_row) || !reader.get(rows) || !reader.get(width) || width != view.width
+                        || first_row < 0 || first_row % band_rows != 0 || first_row >= view.height
+                        || rows != std::min(band_rows, view.height - first_row)
+                        || !reader.read(&buffer.at(0, first_row), (size_t)width * rows * sizeof(int)))
+                        break;
+                    if (!band_done[first_row / band_rows])
+                        result.resumed_bands++;
+                    band_done[first_row / band_rows] = true;
+                }
+                valid_end = std::ftell(file);
+            }
+        }
+        std::fclose(file);
+        file = nullptr;
+        if (valid_end > 0)
+            file = std::fopen(options.path.c_str(), "r+b");
+    }
+
+    // Start a new log, or continue the old one after its last good record,
+    // cutting off anything torn
+    if (file)
+    {
+        std::fseek(file, valid_end, SEEK_SET);
+#ifdef __unix__
+        if (ftruncate(fileno(file), valid_end) != 0)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+#endif
+    }
+    else
+    {
+        file = std::fopen(options.path.c_str(), "wb");
+        std::vector<uint8_t> payload;
+        put(payload, (int32_t)band_rows);
+        payload.insert(payload.end(), description.begin(), description.end());
+        if (file && !(std::fwrite(MAGIC, 1, sizeof(MAGIC), file) == sizeof(MAGIC) && writeRecord(file, JOB, payload)))
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+        band_done.assign((view.height + band_rows - 1) / band_rows, false);
+    }
+    if (!file)
+    {
+        error = "can't write the checkpoint " + options.path;
+        return false;
+    }
+
+    auto scheduler = std::make_shared<TileScheduler>();
+    CpuEngine cpu_engine(scheduler);
+    cpu_engine.fill = job.fill;
+    cpu_engine.interior = job.interior;
+    PerturbationEngine perturbation_engine(scheduler);
+    bool saved_reference = reference.orbit != nullptr;
+#ifdef __unix__
+    auto last_sync = std::chrono::steady_clock::now();
+#endif
+
+    IterationBuffer band;
+    bool ok = true;
+    result.tier = engine_type == EngineType::CPU ? cpuPrecisionTier(cpu_engine.precisionFor(view))
+                                                 : PrecisionTier::PERTURBATION;
+    result.bands = (int)band_done.size();
+    for (int index = 0; index < (int)band_done.size() && ok; index++)
+    {
+        if (band_done[index])
+            continue;
+        int first_row = index * band_rows;
+        int rows = std::min(band_rows, view.height - first_row);
+
+        if (engine_type == EngineType::CPU)
+            ok = cpu_engine.renderBand(view, band, first_row, rows);
+        else
+        {
+            perturbation_engine.options.reference = reference;
+            ok = perturbation_engine.renderBand(view, band, first_row, rows);
+            reference = perturbation_engine.lastStats().primary;
+        }
+        if (!ok)
+        {
+            error = std::string(ENGINES.at(engine_type)) + " engine can't render this view";
+            break;
+        }
+        std::copy(band.iterations.begin(), band.iterations.end(), buffer.iterations.begin() + (size_t)first_row * view.width);
+
+        // The orbit goes first so a resumed run never has bands without it
+        if (!saved_reference && reference.orbit)
+        {
+            ok = writeRecord(file, REFERENCE, referencePayload(reference));
+            saved_reference = true;
+        }
+        std::vector<uint8_t> payload;
+        put(payload, (int32_t)first_row);
+        put(payload, (int32_t)rows);
+        put(payload, (int32_t)view.width);
+        const uint8_t* counts = reinterpret_cast<const uint8_t*>(band.iterations.data());
+        payload.insert(payload.end(), counts, counts + band.iterations.size() * sizeof(int));
+        ok = ok && writeRecord(file, BAND, payload);
+
+#ifdef __unix__
+        // fflush() hands records to the kernel, which is enough if only the
+        // process dies; syncing now and then covers the node going down
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - last_sync).count() >= options.sync_seconds)
+        {
+            fsync(fileno(file));
+            last_sync = std::chrono::steady_clock::now();
+        }
+#endif
+        if (!ok)
+            error = "can't write the checkpoint " + options.path;
+    }
+
+#ifdef __unix__
+    fsync(fileno(file));
+#endif
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+#include "iteration_buffer.h"
+#include "precision_planner.h"
+#include "render_options.h"
+
+struct CheckpointOptions
+{
+    std::string path;
+    int band_rows = 64;         // rows saved at a time; a resumed file keeps its own
+    double sync_seconds = 30.0; // how often saved bands are forced to disk
+};
+
+struct CheckpointStats
+{
+    int bands = 0;
+    int resumed_bands = 0;         // read back instead of rendered
+    bool resumed_reference = false; // perturbation orbit read back too
+    PrecisionTier tier = PrecisionTier::CPU_DOUBLE; // what the bands were rendered in
+};
+
+// Renders `job` band by band on the CPU or perturbation engine (auto picks
+// one of them) and appends each finished band, plus the perturbation
+// engine's primary reference orbit once it exists, to the checkpoint at
+// options.path. If the file already holds a checkpoint of the same job, the
+// bands and orbit in it are read back rather than rendered, so a job killed
+// part way through picks up where it stopped.
+//
+// The file is an append-only log of checksummed records: a crash loses at
+// most the band being written. On resume the log is truncated after its last
+// good record; without ftruncate (non-Unix builds) new records just overwrite
+// the torn tail, and whatever is left of it past them fails its checksum and
+// ends the log there. A file a crash left with only part of its first record
+// starts over. Records are in the machine's byte order. Returns false, with a
+// message in `error`, for other engines, a checkpoint of a different job, or
+// a file that can't be written.
+bool renderCheckpointed(const RenderJob& job, IterationBuffer& buffer, const CheckpointOptions& options,
+                        CheckpointStats* stats, std::string& error);
+
+#endif
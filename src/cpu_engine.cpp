@@ -0,0 +1,510 @@
+#include "cpu_engine.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "formula_kernels.h"
+
+namespace
+{
+
+// Rectangles with fewer interior pixels than this are just computed
+constexpr int MARIANI_SILVER_MIN_INTERIOR = 64;
+
+// Boundary tracing pixel states
+constexpr uint8_t PIXEL_QUEUED = 1;
+constexpr uint8_t PIXEL_DONE = 2;
+
+// Runs one span kernel over parts of a tile. Pixel coordinates come from the
+// precomputed row and column arrays so every path produces the same c.
+template <typename T, typename Kernel>
+struct TileRenderer
+{
+    const std::vector<T>& row_x;    // cx per column
+    const std::vector<T>& column_y; // cy per row
+    std::vector<T>& span_x;
+    std::vector<T>& span_y;
+    std::vector<int>& span_iterations;
+    std::vector<uint8_t>& pixel_state;
+    std::vector<int>& trace_queue;
+    std::vector<int>& trace_batch;
+    Kernel kernel;
+    int max_iterations;
+    IterationBuffer& buffer;
+
+    void horizontal(int x, int y, int count)
+    {
+        span_y.assign(count, column_y[y]);
+        kernel(&row_x[x], span_y.data(), count, max_iterations, &buffer.at(x, y));
+    }
+
+    void vertical(int x, int y, int count)
+    {
+        span_x.assign(count, row_x[x]);
+        span_iterations.resize(count);
+        kernel(span_x.data(), &column_y[y], count, max_iterations, span_iterations.data());
+        for (int i = 0; i < count; i++)
+            buffer.at(x, y + i) = span_iterations[i];
+    }
+
+    void rows(const Tile& tile)
+    {
+        for (int y = tile.y; y < tile.y + tile.height; y++)
+            horizontal(tile.x, y, tile.width);
+    }
+
+    // Mariani-Silver: compute the border, fill the inside if the border is
+    // all one count, otherwise split and recurse
+    void marianiSilver(const Tile& tile)
+    {
+        int x1 = tile.x + tile.width - 1, y1 = tile.y + tile.height - 1;
+        horizontal(tile.x, tile.y, tile.width);
+        if (y1 > tile.y)
+            horizontal(tile.x, y1, tile.width);
+        if (tile.height > 2)
+        {
+            vertical(tile.x, tile.y + 1, tile.height - 2);
+            if (x1 > tile.x)
+                vertical(x1, tile.y + 1, tile.height - 2);
+        }
+        subdivide(tile.x, tile.y, x1, y1);
+    }
+
+    // The border of [x0, x1] x [y0, y1] (inclusive) is already known
+    void subdivide(int x0, int y0, int x1, int y1)
+    {
+        int inner_w = x1 - x0 - 1, inner_h = y1 - y0 - 1;
+        if (inner_w <= 0 || inner_h <= 0)
+            return;
+
+        int value = buffer.at(x0, y0);
+        bool uniform = true;
+        for (int x = x0; x <= x1 && uniform; x++)
+            uniform = buffer.at(x, y0) == value && buffer.at(x, y1) == value;
+        for (int y = y0 + 1; y < y1 && uniform; y++)
+            uniform = buffer.at(x0, y) == value && buffer.at(x1, y) == value;
+
+        if (uniform)
+        {
+            for (int y = y0 + 1; y < y1; y++)
+                std::fill(&buffer.at(x0 + 1, y), &buffer.at(x1, y), value);
+            return;
+        }
+
+        if (inner_w * inner_h < MARIANI_SILVER_MIN_INTERIOR)
+        {
+            for (int y = y0 + 1; y < y1; y++)
+                horizontal(x0 + 1, y, inner_w);
+            return;
+        }
+
+        // Split the longer side with a computed line shared by both halves
+        if (inner_w >= inner_h)
+        {
+            int mid = (x0 + x1) / 2;
+            vertical(mid, y0 + 1, inner_h);
+            subdivide(x0, y0, mid, y1);
+            subdivide(mid, y0, x1, y1);
+        }
+        else
+        {
+            int mid = (y0 + y1) / 2;
+            horizontal(x0 + 1, mid, inner_w);
+            subdivide(x0, y0, x1, mid);
+            subdivide(x0, mid, x1, y1);
+        }
+    }
+
+    // Boundary tracing: starting from the tile edge, compute a pixel's four
+    // neighbours and keep following wherever they differ from it. What's
+    // left unvisited is enclosed by a single count and gets flooded from the
+    // left. The queue is worked in waves so each wave's new pixels can go
+    // through the span kernel together.
+    void boundaryTrace(const Tile& tile)
+    {
+        const int w = tile.width, h = tile.height;
+        pixel_state.assign((size_t)w * h, 0);
+        trace_queue.clear();
+
+        auto enqueue = [&](int p)
+        {
+            if (!(pixel_state[p] & PIXEL_QUEUED))
+            {
+                pixel_state[p] |= PIXEL_QUEUED;
+                trace_queue.push_back(p);
+            }
+        };
+        auto request = [&](int p)
+        {
+            if (!(pixel_state[p] & PIXEL_DONE))
+            {
+                pixel_state[p] |= PIXEL_DONE;
+                trace_batch.push_back(p);
+            }
+        };
+        auto value = [&](int p) { return buffer.at(tile.x + p % w, tile.y + p / w); };
+
+        for (int x = 0; x < w; x++)
+        {
+            enqueue(x);
+            enqueue((h - 1) * w + x);
+        }
+        for (int y = 1; y < h - 1; y++)
+        {
+            enqueue(y * w);
+            enqueue(y * w + w - 1);
+        }
+
+        size_t next = 0;
+        while (next < trace_queue.size())
+        {
+            size_t wave_end = trace_queue.size();
+            trace_batch.clear();
+            for (size_t i = next; i < wave_end; i++)
+            {
+                int p = trace_queue[i];
+                int x = p % w, y = p / w;
+                request(p);
+                if (x > 0) request(p - 1);
+                if (x < w - 1) request(p + 1);
+                if (y > 0) request(p - w);
+                if (y < h - 1) request(p + w);
+            }
+            computeBatch(tile);
+
+            for (; next < wave_end; next++)
+            {
+                int p = trace_queue[next];
+                int x = p % w, y = p / w;
+                int center = value(p);
+                bool has_l = x > 0, has_r = x < w - 1, has_d = y > 0, has_u = y < h - 1;
+                bool l = has_l && value(p - 1) != center;
+                bool r = has_r && value(p + 1) != center;
+                bool d = has_d && value(p - w) != center;
+                bool u = has_u && value(p + w) != center;
+                if (l) enqueue(p - 1);
+                if (r) enqueue(p + 1);
+                if (d) enqueue(p - w);
+                if (u) enqueue(p + w);
+                // Diagonals, so edges that only touch at corners stay closed
+                if (has_l && has_d && (l || d)) enqueue(p - w - 1);
+                if (has_r && has_d && (r || d)) enqueue(p - w + 1);
+                if (has_l && has_u && (l || u)) enqueue(p + w - 1);
+                if (has_r && has_u && (r || u)) enqueue(p + w + 1);
+            }
+        }
+
+        // Column 0 is tile edge, so every row starts with a known count
+        for (int y = 0; y < h; y++)
+        {
+            int* row = &buffer.at(tile.x, tile.y + y);
+            const uint8_t* state = &pixel_state[(size_t)y * w];
+            for (int x = 1; x < w; x++)
+                if (!(state[x] & PIXEL_DONE))
+                    row[x] = row[x - 1];
+        }
+    }
+
+    // Computes the scattered tile pixels listed in trace_batch
+    void computeBatch(const Tile& tile)
+    {
+        int count = (int)trace_batch.size();
+        if (count == 0)
+            return;
+        span_x.resize(count);
+        span_y.resize(count);
+        span_iterations.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            span_x[i] = row_x[tile.x + trace_batch[i] % tile.width];
+            span_y[i] = column_y[tile.y + trace_batch[i] / tile.width];
+        }
+        kernel(span_x.data(), span_y.data(), count, max_iterations, span_iterations.data());
+        for (int i = 0; i < count; i++)
+            buffer.at(tile.x + trace_batch[i] % tile.width, tile.y + trace_batch[i] / tile.width) = span_iterations[i];
+    }
+
+    void render(const Tile& tile, TileFill fill)
+    {
+        switch (fill)
+        {
+            case TileFill::MARIANI_SILVER:
+                marianiSilver(tile);
+                break;
+            case TileFill::BOUNDARY_TRACE:
+                boundaryTrace(tile);
+                break;
+            default:
+                rows(tile);
+                break;
+        }
+    }
+};
+
+// c for each point, in T; offsets from the center stay small enough for
+// double, as in the grid coordinates
+template <typename T, typename Center>
+void pointCoordinates(const View& view, Center center_x, Center center_y, const std::vector<double>& xs,
+                      const std::vector<double>& ys, std::vector<T>& cx, std::vector<T>& cy)
+{
+    double zoom = view.zoom.toDouble();
+    cx.resize(xs.size());
+    cy.resize(ys.size());
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+        cx[i] = T(center_x + Center((xs[i] / view.width - 0.5) * zoom));
+        cy[i] = T(center_y + Center((ys[i] / view.height - 0.5) * zoom));
+    }
+}
+
+template <typename T, typename Kernel>
+TileRenderer<T, Kernel> tileRenderer(const std::vector<T>& row_x, const std::vector<T>& column_y,
+                                     std::vector<T>& span_x, std::vector<T>& span_y, std::vector<int>& span_iterations,
+                                     std::vector<uint8_t>& pixel_state, std::vector<int>& trace_queue, std::vector<int>& trace_batch,
+                                     Kernel kernel, int max_iterations, IterationBuffer& buffer)
+{
+    return { row_x, column_y, span_x, span_y, span_iterations, pixel_state, trace_queue, trace_batch, kernel, max_iterations, buffer };
+}
+
+}
+
+bool floatResolvesView(const View& view)
+{
+    // Leave a few bits between float's ulp at the center and a pixel
+    double magnitude = std::max(1.0, std::max(std::fabs(view.centerX()), std::fabs(view.centerY())));
+    return view.pixelSpacing().log2() > std::log2(magnitude) - 16.0;
+}
+
+bool doubleResolvesView(const View& view)
+{
+    double magnitude = std::max(1.0, std::max(std::fabs(view.centerX()), std::fabs(view.centerY())));
+    return view.pixelSpacing().log2() > std::log2(magnitude) - 45.0;
+}
+
+bool fixed128ResolvesView(const View& view)
+{
+    // Fixed point resolution doesn't depend on the magnitude
+    double radius = view.zoom.toDouble();
+    return view.pixelSpacing().log2() > -(Fixed128::FRACTION_BITS - 8)
+        && fixed128Holds(view.centerX(), view.centerY(), radius);
+}
+
+CpuEngine::CpuEngine(std::shared_ptr<TileScheduler> scheduler)
+    : scheduler(scheduler ? scheduler : std::make_shared<TileScheduler>())
+{
+}
+
+CpuPrecision cpuPrecisionFor(const View& view, const InteriorChecks& interior, bool allow_float, bool allow_fixed)
+{
+    if (allow_float && view.max_iterations <= FLOAT_KERNEL_MAX_ITERATIONS && floatResolvesView(view))
+        return CpuPrecision::FLOAT;
+    if (doubleResolvesView(view))
+        return CpuPrecision::DOUBLE;
+    if (allow_fixed && formulaSpanKernel<Fixed128>(view.fractal, interior) && fixed128ResolvesView(view))
+        return CpuPrecision::FIXED128;
+    return CpuPrecision::DOUBLE_DOUBLE;
+}
+
+CpuPrecision CpuEngine::precisionFor(const View& view) const
+{
+    return cpuPrecisionFor(view, interior, allow_float, allow_fixed);
+}
+
+bool CpuEngine::render(const View& view, IterationBuffer& buffer)
+{
+    return renderRows(view, buffer, 0, view.height);
+}
+
+bool CpuEngine::renderRows(const View& view, IterationBuffer& buffer, int first_row, int last_row)
+{
+    buffer.resize(view.width, view.height);
+    return renderRange(view, buffer, 0, view.height, first_row, last_row);
+}
+
+bool CpuEngine::renderBand(const View& view, IterationBuffer& band, int first_row, int rows)
+{
+    band.resize(view.width, rows);
+    return renderRange(view, band, first_row, rows, 0, rows);
+}
+
+bool CpuEngine::renderRange(const View& view, IterationBuffer& buffer, int coordinate_row, int coordinate_rows,
+                            int first_row, int last_row)
+{
+    CpuPrecision precision = auto_precision ? precisionFor(view) : manual_precision;
+    if (precision == CpuPrecision::FLOAT && view.max_iterations > FLOAT_KERNEL_MAX_ITERATIONS)
+        precision = CpuPrecision::DOUBLE;
+    bool simd = view.fractal == Fractal::MANDELBROT;
+    if (!simd && !formulaSpanKernel<double>(view.fractal, interior))
+        return false;
+    if (precision == CpuPrecision::FIXED128 && !formulaSpanKernel<Fixed128>(view.fractal, interior))
+        return false;
+
+    computeCoordinates(view, precision, coordinate_row, coordinate_rows);
+    last_precision = precision;
+    switch (precision)
+    {
+        case CpuPrecision::FLOAT:
+            if (simd)
+                renderTiles<float>(view, buffer, first_row, last_row, floatSpanKernel(simd_level, interior));
+            else
+                renderTiles<float>(view, buffer, first_row, last_row, formulaSpanKernel<float>(view.fractal, interior));
+            break;
+        case CpuPrecision::DOUBLE:
+            if (simd)
+                renderTiles<double>(view, buffer, first_row, last_row, doubleSpanKernel(simd_level, interior));
+            else
+                renderTiles<double>(view, buffer, first_row, last_row, formulaSpanKernel<double>(view.fractal, interior));
+            break;
+        case CpuPrecision::FIXED128:
+            renderTiles<Fixed128>(view, buffer, first_row, last_row, formulaSpanKernel<Fixed128>(view.fractal, interior));
+            break;
+        case CpuPrecision::DOUBLE_DOUBLE:
+            renderTiles<DoubleDouble>(view, buffer, first_row, last_row, formulaSpanKernel<DoubleDouble>(view.fractal, interior));
+            break;
+    }
+    return !cancelled();
+}
+
+bool CpuEngine::renderPoints(const View& view, const std::vector<double>& xs, const std::vector<double>& ys,
+                             std::vector<int>& iterations)
+{
+    CpuPrecision precision = auto_precision ? precisionFor(view) : manual_precision;
+    if (precision == CpuPrecision::FLOAT && view.max_iterations > FLOAT_KERNEL_MAX_ITERATIONS)
+        precision = CpuPrecision::DOUBLE;
+    bool simd = view.fractal == Fractal::MANDELBROT;
+    if (!simd && !formulaSpanKernel<double>(view.fractal, interior))
+        return false;
+    if (precision == CpuPrecision::FIXED128 && !formulaSpanKernel<Fixed128>(view.fractal, interior))
+        return false;
+
+    last_precision = precision;
+    iterations.resize(xs.size());
+    switch (precision)
+    {
+        case CpuPrecision::FLOAT:
+        {
+            std::vector<float> cx, cy;
+            pointCoordinates(view, view.centerX(), view.centerY(), xs, ys, cx, cy);
+            if (simd)
+                renderPointsAs(cx, cy, view.max_iterations, floatSpanKernel(simd_level, interior), iterations);
+            else
+                renderPointsAs(cx, cy, view.max_iterations, formulaSpanKernel<float>(view.fractal, interior), iterations);
+            break;
+        }
+        case CpuPrecision::DOUBLE:
+        {
+            std::vector<double> cx, cy;
+            pointCoordinates(view, view.centerX(), view.centerY(), xs, ys, cx, cy);
+            if (simd)
+                renderPointsAs(cx, cy, view.max_iterations, doubleSpanKernel(simd_level, interior), iterations);
+            else
+                renderPointsAs(cx, cy, view.max_iterations, formulaSpanKernel<double>(view.fractal, interior), iterations);
+            break;
+        }
+        case CpuPrecision::FIXED128:
+        {
+            std::vector<Fixed128> cx, cy;
+            pointCoordinates(view, Fixed128::fromString(view.center_x), Fixed128::fromString(view.center_y), xs, ys, cx, cy);
+            renderPointsAs(cx, cy, view.max_iterations, formulaSpanKernel<Fixed128>(view.fractal, interior), iterations);
+            break;
+        }
+        case CpuPrecision::DOUBLE_DOUBLE:
+        {
+            std::vector<DoubleDouble> cx, cy;
+            pointCoordinates(view, DoubleDouble::fromString(view.center_x), DoubleDouble::fromString(view.center_y),
+                             xs, ys, cx, cy);
+            renderPointsAs(cx, cy, view.max_iterations, formulaSpanKernel<DoubleDouble>(view.fractal, interior), iterations);
+            break;
+        }
+    }
+    return !cancelled();
+}
+
+template <typename T, typename Kernel>
+void CpuEngine::renderPointsAs(const std::vector<T>& cx, const std::vector<T>& cy, int max_iterations, Kernel kernel,
+                               std::vector<int>& iterations)
+{
+    // Runs of points share a task, like the spans of a tile
+    const int RUN = 256;
+    std::vector<Tile> runs;
+    for (int first = 0; first < (int)cx.size(); first += RUN)
+        runs.push_back({ first, 0, std::min(RUN, (int)cx.size() - first), 1 });
+    scheduler->run(runs, [&](const Tile& run, int)
+    {
+        if (!cancelled())
+            kernel(&cx[run.x], &cy[run.x], run.width, max_iterations, &iterations[run.x]);
+    });
+}
+
+void CpuEngine::computeCoordinates(const View& view, CpuPrecision precision, int first_row, int rows)
+{
+    // uv = (gl_FragCoord.xy / u_resolution - 0.5) * u_zoom + u_center
+    double zoom = view.zoom.toDouble();
+    double center_x = view.centerX(), center_y = view.centerY();
+    std::vector<double>& xs = std::get<std::vector<double>>(row_x);
+    std::vector<double>& ys = std::get<std::vector<double>>(column_y);
+    std::vector<float>& xs_float = std::get<std::vector<float>>(row_x);
+    std::vector<float>& ys_float = std::get<std::vector<float>>(column_y);
+    xs.resize(view.width);
+    xs_float.resize(view.width);
+    for (int x = 0; x < view.width; x++)
+    {
+        xs[x] = ((x + 0.5) / view.width - 0.5) * zoom + center_x;
+        xs_float[x] = (float)xs[x];
+    }
+    ys.resize(rows);
+    ys_float.resize(rows);
+    for (int y = 0; y < rows; y++)
+    {
+        ys[y] = ((first_row + y + 0.5) / view.height - 0.5) * zoom + center_y;
+        ys_float[y] = (float)ys[y];
+    }
+
+    if (precision == CpuPrecision::DOUBLE_DOUBLE)
+        computeWideCoordinates<DoubleDouble>(view, first_row, rows);
+    else if (precision == CpuPrecision::FIXED128)
+        computeWideCoordinates<Fixed128>(view, first_row, rows);
+}
+
+template <typename T>
+void CpuEngine::computeWideCoordinates(const View& view, int first_row, int rows)
+{
+    // The offsets stay small enough for double; only the center needs more
+    double zoom = view.zoom.toDouble();
+    T center_x = T::fromString(view.center_x);
+    T center_y = T::fromString(view.center_y);
+    std::vector<T>& xs = std::get<std::vector<T>>(row_x);
+    std::vector<T>& ys = std::get<std::vector<T>>(column_y);
+    xs.resize(view.width);
+    for (int x = 0; x < view.width; x++)
+        xs[x] = center_x + T(((x + 0.5) / view.width - 0.5) * zoom);
+    ys.resize(rows);
+    for (int y = 0; y < rows; y++)
+        ys[y] = center_y + T(((first_row + y + 0.5) / view.height - 0.5) * zoom);
+}
+
+template <typename T, typename Kernel>
+void CpuEngine::renderTiles(const View& view, IterationBuffer& buffer, int first_row, int last_row, Kernel kernel)
+{
+    const std::vector<T>& xs = std::get<std::vector<T>>(row_x);
+    const std::vector<T>& ys = std::get<std::vector<T>>(column_y);
+    scratch.resize(scheduler->workerCount());
+
+    auto render_tile = [&](const Tile& tile, int worker)
+    {
+        // The remaining tiles still get dealt out, but return straight away
+        if (cancelled())
+            return;
+        // Tiles are laid out over the rows asked for, starting at 0
+        Tile shifted = tile;
+        shifted.y += first_row;
+        WorkerScratch& local = scratch[worker];
+        tileRenderer(xs, ys, std::get<std::vector<T>>(local.span_x), std::get<std::vector<T>>(local.span_y),
+                     local.span_iterations, local.pixel_state, local.trace_queue, local.trace_batch,
+                     kernel, view.max_iterations, buffer).render(shifted, fill);
+    };
+
+    double fx = focus_x < 0.0 ? view.width * 0.5 : focus_x;
+    double fy = (focus_y < 0.0 ? view.height * 0.5 : focus_y) - first_row;
+    scheduler->run(view.width, last_row - first_row, tile_size, fx, fy, render_tile);
+}
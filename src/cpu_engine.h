@@ -0,0 +1,156 @@
+#ifndef CPU_ENGINE_H
+#define CPU_ENGINE_H
+
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "double_double.h"
+#include "engine.h"
+#include "fixed128.h"
+#include "simd_kernels.h"
+#include "tile_scheduler.h"
+
+// How each tile's pixels get their counts. The shortcuts skip pixels inside
+// regions whose outline has a single count; since the escape-count level sets
+// of the Mandelbrot set are simply connected, they agree with FULL wherever the
+// computed pixels resolve the outline.
+enum class TileFill
+{
+    FULL,           // compute every pixel
+    MARIANI_SILVER, // fill rectangles with a uniform border, else subdivide
+    BOUNDARY_TRACE  // compute only the edges between counts, flood the rest
+};
+
+const std::unordered_map<TileFill, const char*> TILE_FILLS = {
+    {TileFill::FULL, "Full"},
+    {TileFill::MARIANI_SILVER, "Mariani-Silver"},
+    {TileFill::BOUNDARY_TRACE, "Boundary trace"}
+};
+
+// Number types the CPU engine can iterate in, cheapest first
+enum class CpuPrecision
+{
+    FLOAT,
+    DOUBLE,
+    FIXED128,
+    DOUBLE_DOUBLE
+};
+
+const std::unordered_map<CpuPrecision, const char*> CPU_PRECISIONS = {
+    {CpuPrecision::FLOAT, "float"},
+    {CpuPrecision::DOUBLE, "double"},
+    {CpuPrecision::FIXED128, "fixed 4.124"},
+    {CpuPrecision::DOUBLE_DOUBLE, "double-double"}
+};
+
+// Escape-time loops mirroring the fragment shaders. Mandelbrot views that
+// float or double resolve run through the widest SIMD kernel the CPU
+// supports; other fractals and deeper views use the formula kernels, in
+// 128-bit fixed point or double-double once double runs out. Also the
+// render path when there's no usable GPU.
+class CpuEngine : public Engine
+{
+public:
+    SimdLevel simd_level = detectSimdLevel();
+    bool allow_float = true; // use float kernels while the pixel spacing allows
+    bool allow_fixed = true; // prefer fixed point over double-double where it holds
+    // Off lets a caller that plans precision itself (AutoEngine) pick the type
+    bool auto_precision = true;
+    CpuPrecision manual_precision = CpuPrecision::DOUBLE;
+    int tile_size = 64;
+    TileFill fill = TileFill::FULL;
+    InteriorChecks interior;
+    // Pixel the user is looking at, rendered first; negative means the center
+    double focus_x = -1.0, focus_y = -1.0;
+
+    // Engines may share one pool
+    explicit CpuEngine(std::shared_ptr<TileScheduler> scheduler = nullptr);
+
+    EngineType type() const override { return EngineType::CPU; }
+    bool render(const View& view, IterationBuffer& buffer) override;
+
+    // Renders only rows [first_row, last_row), leaving the rest of the
+    // buffer as it was (zeroed if the buffer had to grow)
+    bool renderRows(const View& view, IterationBuffer& buffer, int first_row, int last_row);
+
+    // Renders `rows` rows of the view starting at `first_row` into a buffer
+    // holding just those rows, for callers splitting huge frames into bands
+    bool renderBand(const View& view, IterationBuffer& band, int first_row, int rows);
+
+    // Iterates scattered points of the view in the precision it calls for:
+    // point i is at pixel coordinates (xs[i], ys[i]), where pixel (x, y)
+    // spans [x, x + 1) x [y, y + 1), so x + 0.5 gives the same c as render()
+    bool renderPoints(const View& view, const std::vector<double>& xs, const std::vector<double>& ys,
+                      std::vector<int>& iterations);
+
+    // Cheapest number type that resolves `view`
+    CpuPrecision precisionFor(const View& view) const;
+    CpuPrecision lastPrecision() const { return last_precision; }
+
+private:
+    // One vector per number type, picked with std::get<std::vector<T>>
+    typedef std::tuple<std::vector<float>, std::vector<double>, std::vector<DoubleDouble>, std::vector<Fixed128>> Coordinates;
+
+    struct WorkerScratch
+    {
+        Coordinates span_x, span_y;
+        std::vector<int> span_iterations;
+        std::vector<uint8_t> pixel_state;
+        std::vector<int> trace_queue, trace_batch;
+    };
+
+    // Row coordinates start at view row `coordinate_row`; tiles cover buffer
+    // rows [first_row, last_row)
+    bool renderRange(const View& view, IterationBuffer& buffer, int coordinate_row, int coordinate_rows,
+                     int first_row, int last_row);
+
+    void computeCoordinates(const View& view, CpuPrecision precision, int first_row, int rows);
+
+    template <typename T>
+    void computeWideCoordinates(const View& view, int first_row, int rows);
+
+    template <typename T, typename Kernel>
+    void renderPointsAs(const std::vector<T>& cx, const std::vector<T>& cy, int max_iterations, Kernel kernel,
+                        std::vector<int>& iterations);
+
+    template <typename T, typename Kernel>
+    void renderTiles(const View& view, IterationBuffer& buffer, int first_row, int last_row, Kernel kernel);
+
+    std::shared_ptr<TileScheduler> scheduler;
+    Coordinates row_x;    // cx per column
+    Coordinates column_y; // cy per row
+    std::vector<WorkerScratch> scratch;
+    CpuPrecision last_precision = CpuPrecision::DOUBLE;
+};
+
+// Whether coordinates in each number type still resolve neighbouring pixels
+// of `view`
+bool floatResolvesView(const View& view);
+bool doubleResolvesView(const View& view);
+bool fixed128ResolvesView(const View& view);
+
+// CpuEngine::precisionFor() without an engine (or its tile pool)
+CpuPrecision cpuPrecisionFor(const View& view, const InteriorChecks& interior, bool allow_float = true,
+                             bool allow_fixed = true);
+
+// Same loop as renderMandelbrot() in the fragment shader: the index of the
+// iteration that escaped, or max_iterations
+template <typename T>
+inline int iterateMandelbrot(T cx, T cy, int max_iterations)
+{
+    T x = T(0), y = T(0);
+    int i;
+    for (i = 0; i < max_iterations; i++)
+    {
+        T next_x = x * x - y * y + cx;
+        y = T(2) * x * y + cy;
+        x = next_x;
+        if (x * x + y * y > T(4)) break;
+    }
+    return i;
+}
+
+#endif
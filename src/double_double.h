@@ -0,0 +1,90 @@
+#ifndef DOUBLE_DOUBLE_H
+#define DOUBLE_DOUBLE_H
+
+#include <cmath>
+#include <string>
+
+#include "mp_real.h"
+
+// An unevaluated sum hi + lo of two doubles, giving ~106 bits of mantissa at
+// a few times the cost of double. Covers the zoom range just past double
+// before perturbation or the fixed-point tiers take over.
+//
+// The error-free transforms need every operation rounded on its own: build
+// users with -ffp-contract=off.
+
+struct DoubleDouble
+{
+    double hi;
+    double lo;
+
+    DoubleDouble() : hi(0.0), lo(0.0) {}
+    DoubleDouble(double x) : hi(x), lo(0.0) {}
+    DoubleDouble(double hi, double lo) : hi(hi), lo(lo) {}
+
+    // Rounds a decimal string, e.g. a View center, to double-double
+    static DoubleDouble fromString(const std::string& text)
+    {
+        MpReal<3> x = MpReal<3>::fromString(text);
+        double hi = x.toDouble();
+        return DoubleDouble(hi, (x - MpReal<3>(hi)).toDouble());
+    }
+
+    double toDouble() const { return hi + lo; }
+
+    // a + b = s + e exactly
+    static DoubleDouble twoSum(double a, double b)
+    {
+        double s = a + b;
+        double v = s - a;
+        return DoubleDouble(s, (a - (s - v)) + (b - v));
+    }
+
+    static DoubleDouble quickTwoSum(double a, double b)
+    {
+        double s = a + b;
+        return DoubleDouble(s, b - (s - a));
+    }
+
+    // a * b = p + e exactly, by Dekker's splitting
+    static DoubleDouble twoProduct(double a, double b)
+    {
+        const double split = 134217729.0; // 2^27 + 1
+        double p = a * b;
+        double ta = split * a, tb = split * b;
+        double a_hi = ta - (ta - a), b_hi = tb - (tb - b);
+        double a_lo = a - a_hi, b_lo = b - b_hi;
+        return DoubleDouble(p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo);
+    }
+
+    DoubleDouble operator-() const { return DoubleDouble(-hi, -lo); }
+
+    friend DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b)
+    {
+        DoubleDouble s = twoSum(a.hi, b.hi);
+        DoubleDouble t = twoSum(a.lo, b.lo);
+        s = quickTwoSum(s.hi, s.lo + t.hi);
+        return quickTwoSum(s.hi, s.lo + t.lo);
+    }
+
+    friend DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) { return a + (-b); }
+
+    friend DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b)
+    {
+        DoubleDouble p = twoProduct(a.hi, b.hi);
+        return quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+    }
+
+    DoubleDouble& operator+=(const DoubleDouble& other) { return *this = *this + other; }
+    DoubleDouble& operator-=(const DoubleDouble& other) { return *this = *this - other; }
+    DoubleDouble& operator*=(const DoubleDouble& other) { return *this = *this * other; }
+
+    friend bool operator==(const DoubleDouble& a, const DoubleDouble& b) { return a.hi == b.hi && a.lo == b.lo; }
+    friend bool operator<(const DoubleDouble& a, const DoubleDouble& b) { return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo); }
+    friend bool operator>(const DoubleDouble& a, const DoubleDouble& b) { return b < a; }
+};
+
+inline DoubleDouble abs(const DoubleDouble& x) { return x.hi < 0.0 ? -x : x; }
+inline double toDouble(const DoubleDouble& x) { return x.toDouble(); }
+
+#endif
@@ -0,0 +1,147 @@
+#include "egl_context.h"
+
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "glad/glad.h"
+
+namespace
+{
+
+bool hasExtension(EGLDisplay display, const char* name)
+{
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions)
+        return false;
+    size_t length = std::strlen(name);
+    for (const char* found = std::strstr(extensions, name); found; found = std::strstr(found + length, name))
+        if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+            return true;
+    return false;
+}
+
+}
+
+EglContext::EglContext()
+{
+    EGLDisplay egl_display = EGL_NO_DISPLAY;
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display && hasExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless"))
+        egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (egl_display == EGL_NO_DISPLAY)
+        egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, nullptr, nullptr))
+    {
+        fail("no EGL display");
+        return;
+    }
+    display = egl_display;
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        fail("EGL can't bind desktop OpenGL");
+        return;
+    }
+
+    // Without both extensions the context needs a config and a pbuffer
+    bool needs_surface = !hasExtension(egl_display, "EGL_KHR_surfaceless_context");
+    EGLConfig config = nullptr;
+    if (needs_surface || !hasExtension(egl_display, "EGL_KHR_no_config_context"))
+    {
+        const EGLint config_attributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+        EGLint count = 0;
+        if (!eglChooseConfig(egl_display, config_attributes, &config, 1, &count) || count == 0)
+        {
+            fail("no EGL config for an OpenGL pbuffer");
+            return;
+        }
+    }
+
+    for (int minor : { 6, 5 })
+    {
+        const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attributes);
+        if (egl_context != EGL_NO_CONTEXT)
+        {
+            context = egl_context;
+            minor_version = minor;
+            break;
+        }
+    }
+    if (!context)
+    {
+        fail("no GL 4.5 or 4.6 core context");
+        return;
+    }
+
+    if (needs_surface)
+    {
+        const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        EGLSurface egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attributes);
+        if (egl_surface == EGL_NO_SURFACE)
+        {
+            fail("can't create a pbuffer surface");
+            return;
+        }
+        surface = egl_surface;
+    }
+
+    if (!makeCurrent())
+    {
+        fail("can't make the EGL context current");
+        return;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        fail("can't load GL functions");
+}
+
+EglContext::~EglContext()
+{
+    if (!display)
+        return;
+    release();
+    if (surface)
+        eglDestroySurface(display, surface);
+    if (context)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+}
+
+bool EglContext::makeCurrent()
+{
+    EGLSurface egl_surface = surface ? surface : EGL_NO_SURFACE;
+    return context && eglMakeCurrent(display, egl_surface, egl_surface, context);
+}
+
+void EglContext::release()
+{
+    if (display)
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+bool EglContext::fail(const std::string& message)
+{
+    error_message = message;
+    if (display)
+    {
+        release();
+        if (surface)
+            eglDestroySurface(display, surface);
+        if (context)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+    display = context = surface = nullptr;
+    return false;
+}
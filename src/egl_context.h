@@ -0,0 +1,42 @@
+#ifndef EGL_CONTEXT_H
+#define EGL_CONTEXT_H
+
+#include <string>
+
+// A GL context with no window, for running the GPU engines on servers and in
+// CI: EGL's surfaceless platform where the driver offers it (Mesa, NVIDIA),
+// otherwise a 1x1 pbuffer on the default display. Asks for GL 4.6 core and
+// settles for 4.5, which is all Mesa's llvmpipe has; the shaders only need
+// 4.5. Once valid() the context is current on the constructing thread and
+// glad is loaded, so GlEngine renders into its framebuffer as usual.
+class EglContext
+{
+public:
+    EglContext();
+    ~EglContext();
+
+    EglContext(const EglContext&) = delete;
+    EglContext& operator=(const EglContext&) = delete;
+
+    bool valid() const { return context != nullptr; }
+    const std::string& error() const { return error_message; }
+    bool surfaceless() const { return surface == nullptr; }
+    int minorVersion() const { return minor_version; }
+
+    // For handing the context to another thread
+    bool makeCurrent();
+    void release();
+
+private:
+    bool fail(const std::string& message);
+
+    // EGLDisplay, EGLContext and EGLSurface, kept opaque so this header
+    // doesn't drag in EGL's
+    void* display = nullptr;
+    void* context = nullptr;
+    void* surface = nullptr;
+    int minor_version = 0;
+    std::string error_message;
+};
+
+#endif
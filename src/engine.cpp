@@ -0,0 +1,26 @@
+#include "engine.h"
+
+#include "auto_engine.h"
+#include "cpu_engine.h"
+#include "gl_engine.h"
+#include "hybrid_engine.h"
+#include "perturbation_engine.h"
+
+std::unique_ptr<Engine> createEngine(EngineType type)
+{
+    switch (type)
+    {
+        case EngineType::GPU:
+            return std::unique_ptr<Engine>(new GlEngine());
+        case EngineType::CPU:
+            return std::unique_ptr<Engine>(new CpuEngine());
+        case EngineType::PERTURBATION:
+            return std::unique_ptr<Engine>(new PerturbationEngine());
+        case EngineType::AUTO:
+            return std::unique_ptr<Engine>(new AutoEngine());
+        case EngineType::HYBRID:
+            return std::unique_ptr<Engine>(new HybridEngine());
+        default:
+            return nullptr;
+    }
+}
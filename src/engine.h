@@ -0,0 +1,55 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "iteration_buffer.h"
+#include "view.h"
+
+enum class EngineType
+{
+    GPU,
+    CPU,
+    PERTURBATION,
+    AUTO,
+    HYBRID
+};
+
+const std::unordered_map<EngineType, const char*> ENGINES = {
+    {EngineType::GPU, "GPU"},
+    {EngineType::CPU, "CPU"},
+    {EngineType::PERTURBATION, "Perturbation"},
+    {EngineType::AUTO, "Auto"},
+    {EngineType::HYBRID, "Hybrid"}
+};
+
+// A way of turning a View into iteration counts. Engines keep whatever state
+// they can reuse between frames (programs, reference orbits, scratch memory).
+class Engine
+{
+public:
+    virtual ~Engine() {}
+
+    virtual EngineType type() const = 0;
+
+    // Renders `view` into `buffer`, resizing it to the view's size. Returns
+    // false if the engine can't produce this view, or gave up on it because
+    // the cancel flag was raised.
+    virtual bool render(const View& view, IterationBuffer& buffer) = 0;
+
+    // Flag polled between pieces of a render (tiles, rows) so another thread
+    // can abandon a frame nobody wants anymore
+    virtual void setCancelFlag(const std::atomic<bool>* flag) { cancel_flag = flag; }
+
+protected:
+    bool cancelled() const { return cancel_flag && cancel_flag->load(std::memory_order_relaxed); }
+
+    const std::atomic<bool>* cancel_flag = nullptr;
+};
+
+// The GPU, Auto and Hybrid engines expect a current GL context with glad loaded
+std::unique_ptr<Engine> createEngine(EngineType type);
+
+#endif
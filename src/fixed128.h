@@ -0,0 +1,117 @@
+#ifndef FIXED128_H
+#define FIXED128_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "mp_real.h"
+
+// Signed 4.124 fixed point in one 128-bit integer: values in [-8, 8) with
+// ~1e-37 resolution. Between double's limit and perturbation territory this
+// beats double-double, and integer arithmetic makes results bit-exact on
+// every machine.
+//
+// Products are truncated toward zero. Nothing saturates, so callers keep
+// operands small: the escape-time loop checks |x|, |y| <= 2 before squaring,
+// which keeps every intermediate below 8.
+
+struct Fixed128
+{
+    typedef unsigned __int128 Bits;
+
+    static constexpr int FRACTION_BITS = 124;
+
+    Bits bits; // two's complement
+
+    Fixed128() : bits(0) {}
+    Fixed128(double x) : bits(fromDouble(x)) {}
+
+    static Fixed128 fromBits(Bits bits)
+    {
+        Fixed128 result;
+        result.bits = bits;
+        return result;
+    }
+
+    // Exact for |x| < 8; the low bits of small values are simply dropped
+    static Bits fromDouble(double x)
+    {
+        return (Bits)(__int128)std::ldexp(x, FRACTION_BITS);
+    }
+
+    static Fixed128 fromString(const std::string& text)
+    {
+        // MpReal<3> has 128 fraction bits; drop the lowest 4
+        MpReal<3> x = MpReal<3>::fromString(text);
+        return fromBits(((Bits)x.limbs[2] << 124) | ((Bits)x.limbs[1] << 60) | ((Bits)x.limbs[0] >> 4));
+    }
+
+    bool isNegative() const { return (__int128)bits < 0; }
+
+    double toDouble() const { return std::ldexp((double)(__int128)bits, -FRACTION_BITS); }
+
+    Fixed128 operator-() const { return fromBits(~bits + 1); }
+
+    friend Fixed128 operator+(const Fixed128& a, const Fixed128& b) { return fromBits(a.bits + b.bits); }
+    friend Fixed128 operator-(const Fixed128& a, const Fixed128& b) { return fromBits(a.bits - b.bits); }
+
+    // Magnitude product of two values below 8 in magnitude, shifted back to
+    // 4.124: four 64x64 -> 128 multiplies
+    static Bits multiplyMagnitudes(Bits a, Bits b)
+    {
+        const Bits low_mask = ~(uint64_t)0;
+        Bits a_lo = a & low_mask, a_hi = a >> 64;
+        Bits b_lo = b & low_mask, b_hi = b >> 64;
+        Bits lo_lo = a_lo * b_lo;
+        Bits lo_hi = a_lo * b_hi;
+        Bits hi_lo = a_hi * b_lo;
+        Bits hi_hi = a_hi * b_hi;
+        Bits cross = (lo_lo >> 64) + (lo_hi & low_mask) + (hi_lo & low_mask);
+        Bits upper = hi_hi + (lo_hi >> 64) + (hi_lo >> 64) + (cross >> 64);
+        return (upper << (128 - FRACTION_BITS)) | ((cross & low_mask) >> (FRACTION_BITS - 64));
+    }
+
+    friend Fixed128 operator*(const Fixed128& a, const Fixed128& b)
+    {
+        bool negative = a.isNegative() != b.isNegative();
+        Bits magnitude = multiplyMagnitudes(a.isNegative() ? ~a.bits + 1 : a.bits, b.isNegative() ? ~b.bits + 1 : b.bits);
+        return fromBits(negative ? ~magnitude + 1 : magnitude);
+    }
+
+    // Squares need no sign handling and one multiply less
+    Fixed128 squared() const
+    {
+        Bits magnitude = isNegative() ? ~bits + 1 : bits;
+        const Bits low_mask = ~(uint64_t)0;
+        Bits lo = magnitude & low_mask, hi = magnitude >> 64;
+        Bits lo_lo = lo * lo;
+        Bits lo_hi = lo * hi;
+        Bits hi_hi = hi * hi;
+        Bits cross = (lo_lo >> 64) + ((lo_hi & low_mask) << 1);
+        Bits upper = hi_hi + ((lo_hi >> 64) << 1) + (cross >> 64);
+        return fromBits((upper << (128 - FRACTION_BITS)) | ((cross & low_mask) >> (FRACTION_BITS - 64)));
+    }
+
+    Fixed128 doubled() const { return fromBits(bits << 1); }
+
+    Fixed128& operator+=(const Fixed128& other) { return *this = *this + other; }
+    Fixed128& operator-=(const Fixed128& other) { return *this = *this - other; }
+    Fixed128& operator*=(const Fixed128& other) { return *this = *this * other; }
+
+    friend bool operator==(const Fixed128& a, const Fixed128& b) { return a.bits == b.bits; }
+    friend bool operator<(const Fixed128& a, const Fixed128& b) { return (__int128)a.bits < (__int128)b.bits; }
+    friend bool operator>(const Fixed128& a, const Fixed128& b) { return b < a; }
+};
+
+inline Fixed128 abs(const Fixed128& x) { return x.isNegative() ? -x : x; }
+inline double toDouble(const Fixed128& x) { return x.toDouble(); }
+
+// Whether every c within `radius` of the center fits, with room for the
+// first orbit steps
+inline bool fixed128Holds(double center_x, double center_y, double radius)
+{
+    return std::fabs(center_x) + radius < 4.0 && std::fabs(center_y) + radius < 4.0;
+}
+
+#endif
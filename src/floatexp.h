@@ -0,0 +1,209 @@
+#ifndef FLOATEXP_H
+#define FLOATEXP_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+
+// Extended-range floating point: x = mantissa * 2^exponent, with the mantissa
+// kept in [0.5, 1) (or exactly 0). Deltas and derivatives in deep zooms fall
+// far below double's ~1e-308 limit while only needing double-ish precision,
+// so we trade a separate int exponent for range.
+//
+// Normalization works on the IEEE bit pattern instead of calling frexp/ldexp
+// so loops over arrays of these stay branch-free and auto-vectorize.
+
+template <typename T> struct FloatExpTraits;
+
+template <> struct FloatExpTraits<double>
+{
+    typedef uint64_t Bits;
+    static constexpr int MANTISSA_BITS = 52;
+    static constexpr int EXPONENT_BIAS = 1023;
+    static constexpr Bits EXPONENT_MASK = 0x7ff;
+};
+
+template <> struct FloatExpTraits<float>
+{
+    typedef uint32_t Bits;
+    static constexpr int MANTISSA_BITS = 23;
+    static constexpr int EXPONENT_BIAS = 127;
+    static constexpr Bits EXPONENT_MASK = 0xff;
+};
+
+// Exponent used for zero so that it always loses when aligning in add/sub
+constexpr int32_t FLOATEXP_ZERO_EXPONENT = INT_MIN / 4;
+
+// Below a pixel spacing of 2^FLOATEXP_SWITCH_LOG2 plain doubles no longer
+// leave enough headroom for deltas and derivatives; switch to FloatExp.
+constexpr int32_t FLOATEXP_SWITCH_LOG2 = -960;
+
+template <typename T>
+struct FloatExp
+{
+    typedef FloatExpTraits<T> Traits;
+    typedef typename Traits::Bits Bits;
+
+    T mantissa;
+    int32_t exponent;
+
+    FloatExp() : mantissa(0), exponent(FLOATEXP_ZERO_EXPONENT) {}
+    FloatExp(T m, int32_t e) : mantissa(m), exponent(e) { normalize(); }
+    FloatExp(double x)
+    {
+        // frexp rather than normalize() so denormal inputs come out right
+        int e;
+        mantissa = T(std::frexp(x, &e));
+        exponent = x == 0.0 ? FLOATEXP_ZERO_EXPONENT : e;
+    }
+
+    // Build from any value whose exponent is already known, e.g. a log2 zoom
+    static FloatExp fromLog2(double log2_value)
+    {
+        double whole = std::floor(log2_value);
+        return FloatExp(T(std::exp2(log2_value - whole)), int32_t(whole));
+    }
+
+    void normalize()
+    {
+        Bits bits;
+        std::memcpy(&bits, &mantissa, sizeof(T));
+        int32_t raw = int32_t((bits >> Traits::MANTISSA_BITS) & Traits::EXPONENT_MASK);
+        bits = (bits & ~(Traits::EXPONENT_MASK << Traits::MANTISSA_BITS))
+             | (Bits(Traits::EXPONENT_BIAS - 1) << Traits::MANTISSA_BITS);
+        bool zero = mantissa == T(0);
+        std::memcpy(&mantissa, &bits, sizeof(T));
+        exponent = zero ? FLOATEXP_ZERO_EXPONENT : exponent + raw - (Traits::EXPONENT_BIAS - 1);
+        mantissa = zero ? T(0) : mantissa;
+    }
+
+    // 2^k for k in the normal range of T, built directly from bits
+    static T pow2(int32_t k)
+    {
+        Bits bits = Bits(k + Traits::EXPONENT_BIAS) << Traits::MANTISSA_BITS;
+        T result;
+        std::memcpy(&result, &bits, sizeof(T));
+        return result;
+    }
+
+    double toDouble() const
+    {
+        if (exponent < -1074)
+            return 0.0;
+        if (exponent > 1024)
+            return mantissa < 0 ? -HUGE_VAL : HUGE_VAL;
+        return std::ldexp(double(mantissa), exponent);
+    }
+
+    double log2() const
+    {
+        return std::log2(std::fabs(double(mantissa))) + exponent;
+    }
+
+    bool isZero() const { return mantissa == T(0); }
+
+    FloatExp operator-() const
+    {
+        FloatExp result;
+        result.mantissa = -mantissa;
+        result.exponent = exponent;
+        return result;
+    }
+
+    friend FloatExp operator*(const FloatExp& a, const FloatExp& b)
+    {
+        return FloatExp(a.mantissa * b.mantissa, a.exponent + b.exponent);
+    }
+
+    friend FloatExp operator/(const FloatExp& a, const FloatExp& b)
+    {
+        return FloatExp(a.mantissa / b.mantissa, a.exponent - b.exponent);
+    }
+
+    friend FloatExp operator+(const FloatExp& a, const FloatExp& b)
+    {
+        // Anything more than MANTISSA_BITS + 2 binades below is lost anyway
+        const int32_t limit = Traits::MANTISSA_BITS + 2;
+        int32_t diff = a.exponent - b.exponent;
+        if (diff > limit)
+            return a;
+        if (diff < -limit)
+            return b;
+        if (diff >= 0)
+            return FloatExp(a.mantissa + b.mantissa * pow2(-diff), a.exponent);
+        return FloatExp(a.mantissa * pow2(diff) + b.mantissa, b.exponent);
+    }
+
+    friend FloatExp operator-(const FloatExp& a, const FloatExp& b) { return a + (-b); }
+
+    FloatExp& operator+=(const FloatExp& other) { return *this = *this + other; }
+    FloatExp& operator-=(const FloatExp& other) { return *this = *this - other; }
+    FloatExp& operator*=(const FloatExp& other) { return *this = *this * other; }
+    FloatExp& operator/=(const FloatExp& other) { return *this = *this / other; }
+
+    // Multiply by 2^k without touching the mantissa
+    FloatExp scaled(int32_t k) const
+    {
+        FloatExp result = *this;
+        if (!isZero())
+            result.exponent += k;
+        return result;
+    }
+
+    friend bool operator<(const FloatExp& a, const FloatExp& b)
+    {
+        bool a_neg = a.mantissa < 0, b_neg = b.mantissa < 0;
+        if (a.isZero() || b.isZero() || a_neg != b_neg)
+            return a.mantissa < b.mantissa;
+        if (a.exponent != b.exponent)
+            return a_neg ? a.exponent > b.exponent : a.exponent < b.exponent;
+        return a.mantissa < b.mantissa;
+    }
+
+    friend bool operator>(const FloatExp& a, const FloatExp& b) { return b < a; }
+    friend bool operator<=(const FloatExp& a, const FloatExp& b) { return !(b < a); }
+    friend bool operator>=(const FloatExp& a, const FloatExp& b) { return !(a < b); }
+};
+
+template <typename T>
+inline FloatExp<T> abs(const FloatExp<T>& x)
+{
+    FloatExp<T> result = x;
+    result.mantissa = std::fabs(x.mantissa);
+    return result;
+}
+
+template <typename T>
+inline FloatExp<T> sqrt(const FloatExp<T>& x)
+{
+    // Make the exponent even so it halves exactly
+    T m = x.mantissa;
+    int32_t e = x.exponent;
+    if (e & 1)
+    {
+        m *= 2;
+        e -= 1;
+    }
+    return FloatExp<T>(std::sqrt(m), e / 2);
+}
+
+typedef FloatExp<double> floatexp;
+typedef FloatExp<float> floatexpf;
+
+// Conversions so kernels templated on the delta type can treat double and
+// FloatExp alike
+inline double toDouble(double x) { return x; }
+template <typename T> inline double toDouble(const FloatExp<T>& x) { return x.toDouble(); }
+
+template <typename R> inline R fromFloatExp(const floatexp& x);
+template <> inline double fromFloatExp<double>(const floatexp& x) { return x.toDouble(); }
+template <> inline floatexp fromFloatExp<floatexp>(const floatexp& x) { return x; }
+
+// Whether values as small as `pixel_spacing` need the extended range
+inline bool needsFloatExp(const floatexp& pixel_spacing)
+{
+    return !pixel_spacing.isZero() && pixel_spacing.exponent < FLOATEXP_SWITCH_LOG2;
+}
+
+#endif
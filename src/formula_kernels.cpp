@@ -0,0 +1,89 @@
+#include "formula_kernels.h"
+
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+
+template <unsigned CHECKS, typename Formula, int POWER, typename T>
+void formulaSpan(const T* cx, const T* cy, int count, int max_iterations, int* iterations)
+{
+    for (int i = 0; i < count; i++)
+        iterations[i] = iterateFormula<CHECKS, Formula, POWER>(cx[i], cy[i], max_iterations);
+}
+
+// Every instantiation of one formula, indexed by InteriorChecks::mask()
+struct FormulaKernelSet
+{
+    FormulaSpanKernel<float> float_kernels[INTERIOR_CHECK_COMBINATIONS];
+    FormulaSpanKernel<double> double_kernels[INTERIOR_CHECK_COMBINATIONS];
+    FormulaSpanKernel<DoubleDouble> double_double_kernels[INTERIOR_CHECK_COMBINATIONS];
+    FormulaSpanKernel<Fixed128> fixed_kernels[INTERIOR_CHECK_COMBINATIONS]; // power 2 only
+};
+
+template <unsigned CHECKS, typename Formula, int POWER>
+FormulaSpanKernel<Fixed128> fixedFormulaSpan(std::true_type) { return formulaSpan<CHECKS, Formula, POWER, Fixed128>; }
+
+template <unsigned CHECKS, typename Formula, int POWER>
+FormulaSpanKernel<Fixed128> fixedFormulaSpan(std::false_type) { return nullptr; }
+
+template <typename Formula, int POWER, unsigned... CHECKS>
+FormulaKernelSet formulaKernelSet(std::integer_sequence<unsigned, CHECKS...>)
+{
+    return {
+        { formulaSpan<CHECKS, Formula, POWER, float>... },
+        { formulaSpan<CHECKS, Formula, POWER, double>... },
+        { formulaSpan<CHECKS, Formula, POWER, DoubleDouble>... },
+        { fixedFormulaSpan<CHECKS, Formula, POWER>(std::integral_constant<bool, POWER == 2>())... }
+    };
+}
+
+template <typename Formula, int POWER>
+FormulaKernelSet formulaKernelSet()
+{
+    return formulaKernelSet<Formula, POWER>(std::make_integer_sequence<unsigned, INTERIOR_CHECK_COMBINATIONS>());
+}
+
+const std::unordered_map<Fractal, FormulaKernelSet> FORMULA_KERNELS = {
+    {Fractal::MANDELBROT, formulaKernelSet<MandelbrotFormula, 2>()},
+    {Fractal::MULTIBROT3, formulaKernelSet<MandelbrotFormula, 3>()},
+    {Fractal::BURNING_SHIP, formulaKernelSet<BurningShipFormula, 2>()}
+};
+
+const FormulaKernelSet* kernelSetFor(Fractal fractal)
+{
+    auto found = FORMULA_KERNELS.find(fractal);
+    return found != FORMULA_KERNELS.end() ? &found->second : nullptr;
+}
+
+}
+
+template <>
+FormulaSpanKernel<float> formulaSpanKernel<float>(Fractal fractal, const InteriorChecks& checks)
+{
+    const FormulaKernelSet* set = kernelSetFor(fractal);
+    return set ? set->float_kernels[checks.mask()] : nullptr;
+}
+
+template <>
+FormulaSpanKernel<double> formulaSpanKernel<double>(Fractal fractal, const InteriorChecks& checks)
+{
+    const FormulaKernelSet* set = kernelSetFor(fractal);
+    return set ? set->double_kernels[checks.mask()] : nullptr;
+}
+
+template <>
+FormulaSpanKernel<DoubleDouble> formulaSpanKernel<DoubleDouble>(Fractal fractal, const InteriorChecks& checks)
+{
+    const FormulaKernelSet* set = kernelSetFor(fractal);
+    return set ? set->double_double_kernels[checks.mask()] : nullptr;
+}
+
+template <>
+FormulaSpanKernel<Fixed128> formulaSpanKernel<Fixed128>(Fractal fractal, const InteriorChecks& checks)
+{
+    const FormulaKernelSet* set = kernelSetFor(fractal);
+    return set ? set->fixed_kernels[checks.mask()] : nullptr;
+}
@@ -0,0 +1,201 @@
+#ifndef FORMULA_KERNELS_H
+#define FORMULA_KERNELS_H
+
+#include <cmath>
+#include <type_traits>
+
+#include "double_double.h"
+#include "fixed128.h"
+#include "fractals.h"
+#include "interior_checks.h"
+
+// Escape-time kernels generated from templates over the number type, the
+// formula and its integer power. Each combination is its own instantiation
+// with z^n expanded at compile time, so the inner loop has no switches and no
+// indirect calls; formulaSpanKernel() looks the instantiation up by Fractal.
+//
+// For the Mandelbrot set at power 2 these match iterateMandelbrotChecked()
+// exactly. Fixed128 only holds values below 8, so it's limited to power 2
+// formulas, whose intermediates stay in range behind the early-out escape
+// check below. The hand-written SIMD kernels stay the fast path for float and
+// double Mandelbrot renders.
+
+template <typename T>
+struct Complex
+{
+    T re;
+    T im;
+
+    friend Complex operator+(const Complex& a, const Complex& b) { return { a.re + b.re, a.im + b.im }; }
+    friend Complex operator*(const Complex& a, const Complex& b)
+    {
+        return { a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+    }
+};
+
+template <typename T>
+inline Complex<T> square(const Complex<T>& z)
+{
+    return { z.re * z.re - z.im * z.im, T(2) * z.re * z.im };
+}
+
+inline Complex<Fixed128> square(const Complex<Fixed128>& z)
+{
+    return { z.re.squared() - z.im.squared(), (z.re * z.im).doubled() };
+}
+
+// z^N by square-and-multiply, unrolled at compile time
+template <int N>
+struct ComplexPower
+{
+    static_assert(N >= 1, "powers start at 1");
+
+    template <typename T>
+    static Complex<T> apply(const Complex<T>& z) { return apply(z, std::integral_constant<bool, N % 2 == 0>()); }
+
+private:
+    template <typename T>
+    static Complex<T> apply(const Complex<T>& z, std::true_type) { return square(ComplexPower<N / 2>::apply(z)); }
+
+    template <typename T>
+    static Complex<T> apply(const Complex<T>& z, std::false_type) { return z * ComplexPower<N - 1>::apply(z); }
+};
+
+template <>
+struct ComplexPower<1>
+{
+    template <typename T>
+    static Complex<T> apply(const Complex<T>& z) { return z; }
+};
+
+// |z| > 2, the escape test shared by every formula
+template <typename T>
+inline bool escaped(const Complex<T>& z)
+{
+    return z.re * z.re + z.im * z.im > T(4);
+}
+
+// Either coordinate past 2 escapes before anything is squared, so the
+// squares stay below 4 and their sum below 8
+inline bool escaped(const Complex<Fixed128>& z)
+{
+    const Fixed128 two = Fixed128::fromBits((Fixed128::Bits)2 << Fixed128::FRACTION_BITS);
+    if (abs(z.re) > two || abs(z.im) > two)
+        return true;
+    return z.re.squared().bits + z.im.squared().bits > two.bits << 1;
+}
+
+// The cardioid and bulb lie inside this box, where the test's products fit
+inline bool inMainCardioidOrBulb(const Fixed128& cx, const Fixed128& cy)
+{
+    if (!(cx > Fixed128(-1.3) && cx < Fixed128(0.4) && abs(cy) < Fixed128(0.75)))
+        return false;
+    return inMainCardioidOrBulb<Fixed128>(cx, cy);
+}
+
+// Formula policies: one step of the orbit, plus any closed-form interior test
+
+struct MandelbrotFormula
+{
+    template <int POWER, typename T>
+    static Complex<T> step(const Complex<T>& z, const Complex<T>& c) { return ComplexPower<POWER>::apply(z) + c; }
+
+    template <int POWER, typename T>
+    static bool knownInterior(const T& cx, const T& cy) { return POWER == 2 && inMainCardioidOrBulb(cx, cy); }
+};
+
+// Folds z into the first quadrant before raising it to the power
+struct BurningShipFormula
+{
+    template <int POWER, typename T>
+    static Complex<T> step(const Complex<T>& z, const Complex<T>& c)
+    {
+        using std::abs;
+        Complex<T> folded = { abs(z.re), abs(z.im) };
+        return ComplexPower<POWER>::apply(folded) + c;
+    }
+
+    template <int POWER, typename T>
+    static bool knownInterior(const T&, const T&) { return false; }
+};
+
+// The derivative check only has to tell tiny from not, so the wide types
+// track it in double; Fixed128 couldn't hold it once it grows past 8
+template <typename T>
+struct DerivativeReal
+{
+    typedef double type;
+    static double from(const T& x) { return toDouble(x); }
+};
+
+template <>
+struct DerivativeReal<float>
+{
+    typedef float type;
+    static float from(float x) { return x; }
+};
+
+template <>
+struct DerivativeReal<double>
+{
+    typedef double type;
+    static double from(double x) { return x; }
+};
+
+// Index of the escaping iteration, or max_iterations. The cardioid test only
+// applies where the formula has one. The derivative check multiplies by
+// POWER * z^(POWER - 1), whose size is also right for the Burning Ship,
+// since folding z doesn't change |z|.
+template <unsigned CHECKS, typename Formula, int POWER, typename T>
+inline int iterateFormula(const T& cx, const T& cy, int max_iterations)
+{
+    typedef typename DerivativeReal<T>::type D;
+    if ((CHECKS & INTERIOR_CARDIOID) && Formula::template knownInterior<POWER>(cx, cy))
+        return max_iterations;
+
+    const Complex<T> c = { cx, cy };
+    Complex<T> z = { T(0), T(0) };
+    Complex<T> saved = z;
+    Complex<D> dz = { D(1), D(0) };
+    int check_at = 1;
+    int i;
+    for (i = 0; i < max_iterations; i++)
+    {
+        z = Formula::template step<POWER>(z, c);
+        if (escaped(z)) break;
+
+        if (CHECKS & INTERIOR_PERIODICITY)
+        {
+            if (z.re == saved.re && z.im == saved.im)
+                return max_iterations;
+            if (i + 1 == check_at)
+            {
+                saved = z;
+                check_at *= 2;
+            }
+        }
+        if (CHECKS & INTERIOR_DERIVATIVE)
+        {
+            const Complex<D> w = { DerivativeReal<T>::from(z.re), DerivativeReal<T>::from(z.im) };
+            Complex<D> product = ComplexPower<POWER - 1>::apply(w) * dz;
+            dz = { D(POWER) * product.re, D(POWER) * product.im };
+            if (dz.re * dz.re + dz.im * dz.im < D(INTERIOR_DERIVATIVE_EPSILON))
+                return max_iterations;
+        }
+    }
+    return i;
+}
+
+template <typename T>
+using FormulaSpanKernel = void (*)(const T* cx, const T* cy, int count, int max_iterations, int* iterations);
+
+// The kernel for `fractal` in number type T, or nullptr if there's none
+template <typename T>
+FormulaSpanKernel<T> formulaSpanKernel(Fractal fractal, const InteriorChecks& checks);
+
+template <> FormulaSpanKernel<float> formulaSpanKernel<float>(Fractal fractal, const InteriorChecks& checks);
+template <> FormulaSpanKernel<double> formulaSpanKernel<double>(Fractal fractal, const InteriorChecks& checks);
+template <> FormulaSpanKernel<DoubleDouble> formulaSpanKernel<DoubleDouble>(Fractal fractal, const InteriorChecks& checks);
+template <> FormulaSpanKernel<Fixed128> formulaSpanKernel<Fixed128>(Fractal fractal, const InteriorChecks& checks);
+
+#endif
@@ -5,11 +5,15 @@
 
 enum class Fractal
 {
-    MANDELBROT
+    MANDELBROT,
+    MULTIBROT3,
+    BURNING_SHIP
 };
 
 const std::unordered_map<Fractal, const char*> FRACTALS = {
-    {Fractal::MANDELBROT, "Mandelbrot"}
+    {Fractal::MANDELBROT, "Mandelbrot"},
+    {Fractal::MULTIBROT3, "Multibrot (z^3)"},
+    {Fractal::BURNING_SHIP, "Burning Ship"}
 };
 
 #endif
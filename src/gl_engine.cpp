@@ -0,0 +1,338 @@
+#include "gl_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdio>
+
+#include "precision_planner.h"
+#include "shader_loader.h"
+
+namespace
+{
+
+void checkCompileErrors(GLuint shader, std::string type)
+{
+    GLint success;
+    GLchar info_log[1024];
+    if (type != "PROGRAM")
+    {
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shader, 1024, NULL, info_log);
+            std::cerr << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << info_log << "\n -- --------------------------------------------------- -- " << std::endl;
+        }
+    }
+    else
+    {
+        glGetProgramiv(shader, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(shader, 1024, NULL, info_log);
+            std::cerr << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << info_log << "\n -- --------------------------------------------------- -- " << std::endl;
+        }
+    }
+}
+
+const char* shaderName(Fractal fractal)
+{
+    switch (fractal)
+    {
+        case Fractal::MANDELBROT:
+            return "mandelbrot";
+        case Fractal::MULTIBROT3:
+            return "multibrot3";
+        case Fractal::BURNING_SHIP:
+            return "burning_ship";
+        default:
+            return "mandelbrot";
+    }
+}
+
+}
+
+GlEngine::GlEngine(const std::string& shader_directory)
+    : shader_directory(shader_directory)
+{
+    float vertices[] = { // goofy
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f
+    };
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+}
+
+GlEngine::~GlEngine()
+{
+    for (const auto& pair : programs)
+        glDeleteProgram(pair.second);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    if (timer_query)
+        glDeleteQueries(1, &timer_query);
+    if (draw_query)
+        glDeleteQueries(1, &draw_query);
+    if (perturbation_program)
+        glDeleteProgram(perturbation_program);
+    if (reference_buffer)
+        glDeleteBuffers(1, &reference_buffer);
+    if (framebuffer)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &color_texture);
+        glDeleteTextures(1, &iteration_texture);
+    }
+}
+
+GLuint GlEngine::programFor(Fractal fractal)
+{
+    auto found = programs.find(fractal);
+    if (found != programs.end())
+        return found->second;
+
+    std::string directory = shader_directory + "/" + shaderName(fractal);
+    GLuint shader_program = buildProgram(directory + "/vertex_shader.glsl", directory + "/fragment_shader.glsl");
+    programs[fractal] = shader_program;
+    return shader_program;
+}
+
+GLuint GlEngine::programFor(const View& view)
+{
+    // Past what float can address, the Mandelbrot set goes through
+    // perturbation against a reference orbit iterated on the CPU
+    if (view.fractal != Fractal::MANDELBROT || PrecisionPlanner::headroomBits(PrecisionTier::GPU_FLOAT, view) > 0.0)
+        return programFor(view.fractal);
+
+    if (!reference.orbit || view != reference_view)
+    {
+        PerturbationOptions options;
+        options.cancel = cancel_flag;
+        reference = findPrimaryReference(view.center_x, view.center_y, view.zoom, view.width, view.height,
+                                         view.max_iterations, options);
+        reference_view = view;
+        if (cancelled())
+        {
+            // A cancelled orbit comes back short; the frame is dropped anyway
+            reference = PrimaryReference();
+            return programFor(view.fractal);
+        }
+
+        std::vector<float> orbit(2 * reference.orbit->length());
+        for (int i = 0; i < reference.orbit->length(); i++)
+        {
+            orbit[2 * i] = (float)reference.orbit->re[i];
+            orbit[2 * i + 1] = (float)reference.orbit->im[i];
+        }
+        if (!reference_buffer)
+            glGenBuffers(1, &reference_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, reference_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, orbit.size() * sizeof(float), orbit.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    if (!perturbation_program)
+    {
+        std::string directory = shader_directory + "/mandelbrot";
+        perturbation_program = buildProgram(directory + "/vertex_shader.glsl",
+                                            directory + "/perturbation_fragment_shader.glsl");
+    }
+    return perturbation_program;
+}
+
+GLuint GlEngine::buildProgram(const std::string& vertex_path, const std::string& fragment_path)
+{
+    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+
+    // Load and compile vertex shader
+    std::string vertex_shader_source_string = loadShaderSource(vertex_path);
+    const char* vertex_shader_source = vertex_shader_source_string.c_str();
+    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
+    glCompileShader(vertex_shader);
+    checkCompileErrors(vertex_shader, "VERTEX");
+
+    // Load and compile fragment shader
+    std::string fragment_shader_source_string = loadShaderSource(fragment_path);
+    const char* fragment_shader_source = fragment_shader_source_string.c_str();
+    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
+    glCompileShader(fragment_shader);
+    checkCompileErrors(fragment_shader, "FRAGMENT");
+
+    // Link shaders to program
+    GLuint shader_program = glCreateProgram();
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+    glLinkProgram(shader_program);
+    checkCompileErrors(shader_program, "PROGRAM");
+
+    // Clean up shaders; they're linked to the program now
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    return shader_program;
+}
+
+void GlEngine::drawQuad(GLuint program, const View& view, int x, int y, int first_row, int last_row)
+{
+    // The viewport spans the whole view so pixels keep their coordinates;
+    // the scissor limits shading to the rows asked for
+    glViewport(x, y, view.width, view.height);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y + first_row, view.width, last_row - first_row);
+
+    // Use the shader program and update uniforms
+    glUseProgram(program);
+    glUniform2f(glGetUniformLocation(program, "u_origin"), (float)x, (float)y);
+    glUniform2f(glGetUniformLocation(program, "u_resolution"), (float)view.width, (float)view.height);
+    glUniform2f(glGetUniformLocation(program, "u_center"), (float)view.centerX(), (float)view.centerY());
+    glUniform1f(glGetUniformLocation(program, "u_zoom"), (float)view.zoom.toDouble());
+    glUniform1i(glGetUniformLocation(program, "u_max_iterations"), view.max_iterations);
+    glUniform1i(glGetUniformLocation(program, "u_cardioid_check"), interior.cardioid);
+    glUniform1i(glGetUniformLocation(program, "u_periodicity_check"), interior.periodicity);
+    glUniform1i(glGetUniformLocation(program, "u_derivative_check"), interior.derivative);
+    if (program == perturbation_program)
+    {
+        // The reference's offset from the center as one cfloatexp, both
+        // parts on the larger exponent
+        const floatexp& offset_x = reference.offset_x;
+        const floatexp& offset_y = reference.offset_y;
+        int exponent = std::max(offset_x.exponent, offset_y.exponent);
+        glUniform2f(glGetUniformLocation(program, "u_reference_offset_mantissa"),
+                    (float)std::ldexp(offset_x.mantissa, offset_x.exponent - exponent),
+                    (float)std::ldexp(offset_y.mantissa, offset_y.exponent - exponent));
+        glUniform1i(glGetUniformLocation(program, "u_reference_offset_exponent"), exponent);
+        glUniform1f(glGetUniformLocation(program, "u_zoom_mantissa"), (float)view.zoom.mantissa);
+        glUniform1i(glGetUniformLocation(program, "u_zoom_exponent"), view.zoom.exponent);
+        glUniform1i(glGetUniformLocation(program, "u_reference_length"), reference.orbit->length());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, reference_buffer);
+    }
+
+    // Draw quad
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void GlEngine::draw(const View& view, int x, int y)
+{
+    if (draw_query_pending)
+    {
+        drawQuad(programFor(view), view, x, y, 0, view.height);
+        return;
+    }
+
+    if (!draw_query)
+        glGenQueries(1, &draw_query);
+    glBeginQuery(GL_TIME_ELAPSED, draw_query);
+    drawQuad(programFor(view), view, x, y, 0, view.height);
+    glEndQuery(GL_TIME_ELAPSED);
+    draw_query_pending = true;
+    draw_view = view;
+    draw_start = std::chrono::steady_clock::now();
+}
+
+bool GlEngine::finishedDraw(View& view, double& seconds)
+{
+    if (!draw_query_pending)
+        return false;
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(draw_query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(draw_query, GL_QUERY_RESULT, &nanoseconds);
+    draw_query_pending = false;
+    view = draw_view;
+    // As in HybridEngine, junk from the driver is capped by the wall clock
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - draw_start).count();
+    seconds = std::min(nanoseconds * 1e-9, wall_seconds);
+    return true;
+}
+
+void GlEngine::resizeFramebuffer(int width, int height)
+{
+    if (framebuffer && width == framebuffer_width && height == framebuffer_height)
+        return;
+
+    if (!framebuffer)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &color_texture);
+        glGenTextures(1, &iteration_texture);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, color_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, iteration_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, width, height, 0, GL_RED_INTEGER, GL_INT, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, iteration_texture, 0);
+    GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, draw_buffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    framebuffer_width = width;
+    framebuffer_height = height;
+}
+
+bool GlEngine::render(const View& view, IterationBuffer& buffer)
+{
+    if (!beginRows(view, 0, view.height))
+        return false;
+    buffer.resize(view.width, view.height);
+    finishRows(buffer);
+    return true;
+}
+
+bool GlEngine::beginRows(const View& view, int first_row, int last_row)
+{
+    resizeFramebuffer(view.width, view.height);
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+        return false;
+    }
+
+    if (!timer_query)
+        glGenQueries(1, &timer_query);
+    glBeginQuery(GL_TIME_ELAPSED, timer_query);
+    drawQuad(programFor(view), view, 0, 0, first_row, last_row);
+    glEndQuery(GL_TIME_ELAPSED);
+    glFlush(); // start the GPU on it now rather than at the read
+
+    pending_first_row = first_row;
+    pending_last_row = last_row;
+    return true;
+}
+
+void GlEngine::finishRows(IterationBuffer& buffer)
+{
+    if (pending_last_row > pending_first_row)
+    {
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, pending_first_row, buffer.width, pending_last_row - pending_first_row, GL_RED_INTEGER, GL_INT,
+                     &buffer.at(0, pending_first_row));
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &nanoseconds);
+    last_gpu_seconds = nanoseconds * 1e-9;
+}
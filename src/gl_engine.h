@@ -0,0 +1,79 @@
+#ifndef GL_ENGINE_H
+#define GL_ENGINE_H
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+#include "glad/glad.h"
+#include "engine.h"
+#include "interior_checks.h"
+#include "perturbation.h"
+
+// Runs the per-fractal fragment shaders. Needs a current GL 4.5 or later
+// context with glad loaded; programs are compiled once per fractal and kept.
+// Mandelbrot views past float range switch to a perturbation shader, whose
+// reference orbit is found and iterated on the CPU once per view.
+class GlEngine : public Engine
+{
+public:
+    explicit GlEngine(const std::string& shader_directory = "../shaders");
+    ~GlEngine();
+
+    InteriorChecks interior;
+
+    EngineType type() const override { return EngineType::GPU; }
+
+    // Renders offscreen and reads the iteration counts back
+    bool render(const View& view, IterationBuffer& buffer) override;
+
+    // Queues rows [first_row, last_row) of `view` offscreen and returns
+    // without waiting for them, so the caller can do other work while the
+    // GPU runs; finishRows() then reads them into the buffer, which must
+    // already be sized to the view
+    bool beginRows(const View& view, int first_row, int last_row);
+    void finishRows(IterationBuffer& buffer);
+
+    // GPU time spent on the rows of the last finishRows(), from a timer query
+    double lastGpuSeconds() const { return last_gpu_seconds; }
+
+    // Draws straight into the bound framebuffer, with (x, y) the bottom left
+    // corner of the view in window coordinates. One draw at a time is timed
+    // with a timer query; the ones issued while it's in flight go untimed.
+    void draw(const View& view, int x, int y);
+
+    // Gives the view and GPU time of the timed draw once its query has come
+    // back, without waiting for it; false while none is ready
+    bool finishedDraw(View& view, double& seconds);
+
+private:
+    GLuint programFor(Fractal fractal);
+    GLuint programFor(const View& view);
+    GLuint buildProgram(const std::string& vertex_path, const std::string& fragment_path);
+    void drawQuad(GLuint program, const View& view, int x, int y, int first_row, int last_row);
+    void resizeFramebuffer(int width, int height);
+
+    std::string shader_directory;
+    std::unordered_map<Fractal, GLuint> programs;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint framebuffer = 0;
+    GLuint color_texture = 0;
+    GLuint iteration_texture = 0;
+    int framebuffer_width = 0;
+    int framebuffer_height = 0;
+    GLuint timer_query = 0;
+    GLuint draw_query = 0;
+    bool draw_query_pending = false;
+    View draw_view;
+    std::chrono::steady_clock::time_point draw_start;
+    GLuint perturbation_program = 0;
+    GLuint reference_buffer = 0; // the reference orbit, for the perturbation shader
+    PrimaryReference reference;
+    View reference_view;
+    GLint previous_framebuffer = 0;
+    int pending_first_row = 0, pending_last_row = 0;
+    double last_gpu_seconds = 0.0;
+};
+
+#endif
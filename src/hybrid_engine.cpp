@@ -0,0 +1,73 @@
+#include "hybrid_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+
+// Weight of the newest frame's split, and the least either side keeps so
+// its speed stays measured
+constexpr double SHARE_SMOOTHING = 0.5;
+constexpr double MIN_SHARE = 0.02;
+
+}
+
+HybridEngine::HybridEngine(std::shared_ptr<TileScheduler> scheduler, const std::string& shader_directory)
+    : gl_engine(shader_directory), cpu_engine(scheduler)
+{
+}
+
+void HybridEngine::setCancelFlag(const std::atomic<bool>* flag)
+{
+    Engine::setCancelFlag(flag);
+    cpu_engine.setCancelFlag(flag);
+}
+
+void HybridEngine::setInterior(const InteriorChecks& interior)
+{
+    gl_engine.interior = interior;
+    cpu_engine.interior = interior;
+}
+
+bool HybridEngine::render(const View& view, IterationBuffer& buffer)
+{
+    if (!floatResolvesView(view))
+    {
+        last_gpu_rows = 0;
+        return cpu_engine.render(view, buffer);
+    }
+
+    // The GPU takes the bottom rows; its band is queued before the CPU starts
+    int split = std::min(view.height, std::max(0, (int)std::lround(gpu_share * view.height)));
+    buffer.resize(view.width, view.height);
+    auto start = std::chrono::steady_clock::now();
+    if (split > 0 && !gl_engine.beginRows(view, 0, split))
+        split = 0;
+
+    auto cpu_start = std::chrono::steady_clock::now();
+    bool rendered = cpu_engine.renderRows(view, buffer, split, view.height);
+    last_cpu_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cpu_start).count();
+    if (split > 0)
+    {
+        gl_engine.finishRows(buffer);
+        // Some drivers return junk for the first timer query; the GPU can't
+        // have taken longer than the wall clock
+        double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        last_gpu_seconds = std::min(gl_engine.lastGpuSeconds(), wall_seconds);
+    }
+    last_gpu_rows = split;
+    if (!rendered)
+        return false;
+
+    // Split the next frame by each side's rows per second
+    if (split > 0 && split < view.height && last_gpu_seconds > 0.0 && last_cpu_seconds > 0.0)
+    {
+        double gpu_rate = split / last_gpu_seconds;
+        double cpu_rate = (view.height - split) / last_cpu_seconds;
+        gpu_share += SHARE_SMOOTHING * (gpu_rate / (gpu_rate + cpu_rate) - gpu_share);
+    }
+    gpu_share = std::min(1.0 - MIN_SHARE, std::max(MIN_SHARE, gpu_share));
+    return true;
+}
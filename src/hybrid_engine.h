@@ -0,0 +1,46 @@
+#ifndef HYBRID_ENGINE_H
+#define HYBRID_ENGINE_H
+
+#include <memory>
+#include <string>
+
+#include "cpu_engine.h"
+#include "engine.h"
+#include "gl_engine.h"
+
+// Splits each frame between the GPU and the CPU pool so neither sits idle:
+// the GPU shades a band of rows at the bottom while the CPU's tiles fill the
+// rest, both into the same buffer. The band's share follows the measured
+// rows per second on each side, so both finish at about the same time.
+// Views float can't resolve go to the CPU alone. Needs a current GL context
+// like GlEngine.
+class HybridEngine : public Engine
+{
+public:
+    // Fraction of rows the GPU renders; adjusted after every frame
+    double gpu_share = 0.5;
+
+    explicit HybridEngine(std::shared_ptr<TileScheduler> scheduler = nullptr,
+                          const std::string& shader_directory = "../shaders");
+
+    EngineType type() const override { return EngineType::HYBRID; }
+    bool render(const View& view, IterationBuffer& buffer) override;
+    void setCancelFlag(const std::atomic<bool>* flag) override;
+
+    void setInterior(const InteriorChecks& interior);
+    CpuEngine& cpu() { return cpu_engine; }
+
+    // Rows the GPU rendered last frame, and each side's time on them
+    int lastGpuRows() const { return last_gpu_rows; }
+    double lastGpuSeconds() const { return last_gpu_seconds; }
+    double lastCpuSeconds() const { return last_cpu_seconds; }
+
+private:
+    GlEngine gl_engine;
+    CpuEngine cpu_engine;
+    int last_gpu_rows = 0;
+    double last_gpu_seconds = 0.0;
+    double last_cpu_seconds = 0.0;
+};
+
+#endif
@@ -0,0 +1,383 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifdef LEIBNIZ_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+
+// Binary PPM (P6)
+class PpmWriter : public ImageWriter
+{
+public:
+    PpmWriter(FILE* file, int width, int height)
+        : file(file), width(width)
+    {
+        ok = std::fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    }
+
+    ~PpmWriter() override
+    {
+        if (file)
+            std::fclose(file);
+    }
+
+    bool writeRows(const uint8_t* rgb, int rows) override
+    {
+        size_t bytes = (size_t)width * 3 * rows;
+        ok = ok && std::fwrite(rgb, 1, bytes, file) == bytes;
+        return ok;
+    }
+
+    bool finish() override
+    {
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* file;
+    int width;
+    bool ok;
+};
+
+#ifdef LEIBNIZ_HAVE_ZLIB
+
+// Rows go through one deflate stream; each time its output buffer fills it
+// becomes an IDAT chunk, so memory stays at a row plus the buffer
+class PngWriter : public ImageWriter
+{
+public:
+    PngWriter(FILE* file, int width, int height)
+        : file(file), width(width), output(1 << 16)
+    {
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        ok = deflateInit(&stream, Z_DEFAULT_COMPRESSION) == Z_OK;
+
+        static const uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        ok = ok && std::fwrite(SIGNATURE, 1, sizeof(SIGNATURE), file) == sizeof(SIGNATURE);
+
+        uint8_t header[13];
+        putBigEndian(header, (uint32_t)width);
+        putBigEndian(header + 4, (uint32_t)height);
+        header[8] = 8;  // bits per channel
+        header[9] = 2;  // RGB
+        header[10] = 0; // deflate
+        header[11] = 0; // adaptive filtering
+        header[12] = 0; // no interlace
+        writeChunk("IHDR", header, sizeof(header));
+    }
+
+    ~PngWriter() override
+    {
+        deflateEnd(&stream);
+        if (file)
+            std::fclose(file);
+    }
+
+    bool writeRows(const uint8_t* rgb, int rows) override
+    {
+        // Each row starts with its filter type; "up" suits smooth images
+        size_t stride = (size_t)width * 3;
+        filtered.resize(stride + 1);
+        previous.resize(stride, 0);
+        for (int row = 0; row < rows && ok; row++)
+        {
+            const uint8_t* pixels = rgb + stride * row;
+            filtered[0] = 2;
+            for (size_t i = 0; i < stride; i++)
+                filtered[i + 1] = (uint8_t)(pixels[i] - previous[i]);
+            std::copy(pixels, pixels + stride, previous.begin());
+            deflateBytes(filtered.data(), filtered.size(), Z_NO_FLUSH);
+        }
+        return ok;
+    }
+
+    bool finish() override
+    {
+        deflateBytes(nullptr, 0, Z_FINISH);
+        writeChunk("IEND", nullptr, 0);
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    static void putBigEndian(uint8_t* bytes, uint32_t value)
+    {
+        bytes[0] = (uint8_t)(value >> 24);
+        bytes[1] = (uint8_t)(value >> 16);
+        bytes[2] = (uint8_t)(value >> 8);
+        bytes[3] = (uint8_t)value;
+    }
+
+    void writeChunk(const char* type, const uint8_t* data, size_t size)
+    {
+        uint8_t length[4], crc_bytes[4];
+        putBigEndian(length, (uint32_t)size);
+        uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+        if (size)
+            crc = crc32(crc, data, (uInt)size);
+        putBigEndian(crc_bytes, (uint32_t)crc);
+        ok = ok && std::fwrite(length, 1, 4, file) == 4 && std::fwrite(type, 1, 4, file) == 4
+            && (!size || std::fwrite(data, 1, size, file) == size) && std::fwrite(crc_bytes, 1, 4, file) == 4;
+    }
+
+    void deflateBytes(const uint8_t* data, size_t size, int flush)
+    {
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = (uInt)size;
+        int status;
+        do
+        {
+            stream.next_out = output.data() + pending;
+            stream.avail_out = (uInt)(output.size() - pending);
+            status = deflate(&stream, flush);
+            pending = output.size() - stream.avail_out;
+            if (pending == output.size() || (flush == Z_FINISH && pending > 0))
+            {
+                writeChunk("IDAT", output.data(), pending);
+                pending = 0;
+            }
+        } while (ok && (stream.avail_in > 0 || (flush == Z_FINISH && status != Z_STREAM_END)));
+    }
+
+    FILE* file;
+    int width;
+    bool ok;
+    z_stream stream;
+    std::vector<uint8_t> output;
+    size_t pending = 0;
+    std::vector<uint8_t> filtered, previous;
+};
+
+#endif
+
+// Baseline RGB TIFF. Uncompressed strips have sizes known up front, so the
+// directory, offsets and all, goes ahead of the pixels and the rows can
+// stream straight out, even to a pipe. Images past 4 GB get the BigTIFF
+// layout and its 64-bit offsets.
+class TiffWriter : public ImageWriter
+{
+public:
+    TiffWriter(FILE* file, int width, int height)
+        : file(file), width(width)
+    {
+        const uint64_t STRIP_ROWS = 16;
+        uint64_t row_bytes = (uint64_t)width * 3;
+        uint64_t strips = ((uint64_t)height + STRIP_ROWS - 1) / STRIP_ROWS;
+        big = row_bytes * height + 0x100000 + strips * 16 > 0xffffffffu;
+        int offset_type = big ? LONG8 : LONG;
+
+        std::vector<Entry> entries = {
+            { 256, LONG, { (uint64_t)width } },     // image width
+            { 257, LONG, { (uint64_t)height } },    // image length
+            { 258, SHORT, { 8, 8, 8 } },            // bits per sample
+            { 259, SHORT, { 1 } },                  // no compression
+            { 262, SHORT, { 2 } },                  // RGB
+            { 273, offset_type, {} },               // strip offsets
+            { 277, SHORT, { 3 } },                  // samples per pixel
+            { 278, LONG, { STRIP_ROWS } },          // rows per strip
+            { 279, offset_type, {} },               // strip byte counts
+            { 282, RATIONAL, { 72, 1 } },           // x resolution
+            { 283, RATIONAL, { 72, 1 } },           // y resolution
+            { 284, SHORT, { 1 } },                  // interleaved
+            { 296, SHORT, { 2 } }                   // resolution in inches
+        };
+        entries[5].values.resize(strips);
+        entries[8].values.resize(strips);
+
+        // Header, directory, values too big to sit in their entries, pixels
+        uint64_t header_size = big ? 16 : 8;
+        uint64_t entry_size = big ? 20 : 12;
+        uint64_t inline_size = big ? 8 : 4;
+        uint64_t directory_size = (big ? 16 : 6) + entry_size * entries.size();
+        uint64_t data_offset = header_size + directory_size;
+        for (const Entry& entry : entries)
+            if (entry.bytes() > inline_size)
+                data_offset += (entry.bytes() + 1) & ~(uint64_t)1;
+        for (uint64_t strip = 0; strip < strips; strip++)
+        {
+            uint64_t rows = std::min(STRIP_ROWS, (uint64_t)height - strip * STRIP_ROWS);
+            entries[5].values[strip] = data_offset + strip * STRIP_ROWS * row_bytes;
+            entries[8].values[strip] = rows * row_bytes;
+        }
+
+        std::vector<uint8_t> head, external;
+        head.push_back('I');
+        head.push_back('I');
+        if (big)
+        {
+            putLittleEndian(head, 43, 2);
+            putLittleEndian(head, 8, 2); // offset size
+            putLittleEndian(head, 0, 2);
+            putLittleEndian(head, header_size, 8);
+            putLittleEndian(head, entries.size(), 8);
+        }
+        else
+        {
+            putLittleEndian(head, 42, 2);
+            putLittleEndian(head, header_size, 4);
+            putLittleEndian(head, entries.size(), 2);
+        }
+        uint64_t external_offset = header_size + directory_size;
+        for (const Entry& entry : entries)
+        {
+            putLittleEndian(head, entry.tag, 2);
+            putLittleEndian(head, entry.type, 2);
+            putLittleEndian(head, entry.type == RATIONAL ? entry.values.size() / 2 : entry.values.size(), inline_size);
+            std::vector<uint8_t> value_bytes;
+            for (uint64_t value : entry.values)
+                putLittleEndian(value_bytes, value, entry.type == RATIONAL ? 4 : typeSize(entry.type));
+            if (value_bytes.size() > inline_size)
+            {
+                putLittleEndian(head, external_offset + external.size(), inline_size);
+                external.insert(external.end(), value_bytes.begin(), value_bytes.end());
+                if (external.size() & 1)
+                    external.push_back(0);
+            }
+            else
+            {
+                value_bytes.resize(inline_size, 0);
+                head.insert(head.end(), value_bytes.begin(), value_bytes.end());
+            }
+        }
+        putLittleEndian(head, 0, inline_size); // no further directories
+        head.insert(head.end(), external.begin(), external.end());
+        ok = std::fwrite(head.data(), 1, head.size(), file) == head.size();
+    }
+
+    ~TiffWriter() override
+    {
+        if (file)
+            std::fclose(file);
+    }
+
+    bool writeRows(const uint8_t* rgb, int rows) override
+    {
+        size_t bytes = (size_t)width * 3 * rows;
+        ok = ok && std::fwrite(rgb, 1, bytes, file) == bytes;
+        return ok;
+    }
+
+    bool finish() override
+    {
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    enum { SHORT = 3, LONG = 4, RATIONAL = 5, LONG8 = 16 };
+
+    struct Entry
+    {
+        uint16_t tag;
+        int type;
+        std::vector<uint64_t> values; // rationals as numerator, denominator pairs
+
+        uint64_t bytes() const { return values.size() * (type == RATIONAL ? 4 : typeSize(type)); }
+    };
+
+    static int typeSize(int type)
+    {
+        return type == SHORT ? 2 : type == LONG ? 4 : 8;
+    }
+
+    static void putLittleEndian(std::vector<uint8_t>& bytes, uint64_t value, uint64_t size)
+    {
+        for (uint64_t i = 0; i < size; i++)
+            bytes.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    FILE* file;
+    int width;
+    bool big;
+    bool ok;
+};
+
+bool endsWith(const std::string& text, const std::string& suffix)
+{
+    if (text.size() < suffix.size())
+        return false;
+    return std::equal(suffix.begin(), suffix.end(), text.end() - suffix.size(),
+                      [](char a, char b) { return a == std::tolower((unsigned char)b); });
+}
+
+}
+
+ImageFormat imageFormatFor(const std::string& path)
+{
+    if (endsWith(path, ".png"))
+        return ImageFormat::PNG;
+    if (endsWith(path, ".tif") || endsWith(path, ".tiff"))
+        return ImageFormat::TIFF;
+    return ImageFormat::PPM;
+}
+
+std::unique_ptr<ImageWriter> openImageWriter(const std::string& path, int width, int height)
+{
+    return openImageWriter(path, width, height, imageFormatFor(path));
+}
+
+std::unique_ptr<ImageWriter> openImageWriter(const std::string& path, int width, int height, ImageFormat format)
+{
+#ifndef LEIBNIZ_HAVE_ZLIB
+    if (format == ImageFormat::PNG)
+        return nullptr;
+#endif
+    FILE* file = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    if (!file)
+        return nullptr;
+
+#ifdef LEIBNIZ_HAVE_ZLIB
+    if (format == ImageFormat::PNG)
+        return std::unique_ptr<ImageWriter>(new PngWriter(file, width, height));
+#endif
+    if (format == ImageFormat::TIFF)
+        return std::unique_ptr<ImageWriter>(new TiffWriter(file, width, height));
+    return std::unique_ptr<ImageWriter>(new PpmWriter(file, width, height));
+}
+
+void grayscaleRows(const IterationBuffer& buffer, int max_iterations, int first_row, int rows, std::vector<uint8_t>& rgb)
+{
+    rgb.resize((size_t)buffer.width * 3 * rows);
+    uint8_t* out = rgb.data();
+    for (int row = 0; row < rows; row++)
+    {
+        for (int x = 0; x < buffer.width; x++)
+        {
+            uint8_t value = (uint8_t)(255.0f * buffer.at(x, first_row - row) / max_iterations + 0.5f);
+            *out++ = value;
+            *out++ = value;
+            *out++ = value;
+        }
+    }
+}
+
+bool writeImage(const std::string& path, const IterationBuffer& buffer, int max_iterations)
+{
+    std::unique_ptr<ImageWriter> writer = openImageWriter(path, buffer.width, buffer.height);
+    if (!writer)
+        return false;
+
+    // A band at a time keeps the RGB copy small
+    const int BAND_ROWS = 64;
+    std::vector<uint8_t> rgb;
+    for (int row = buffer.height - 1; row >= 0; row -= BAND_ROWS)
+    {
+        int rows = std::min(BAND_ROWS, row + 1);
+        grayscaleRows(buffer, max_iterations, row, rows, rgb);
+        if (!writer->writeRows(rgb.data(), rows))
+            return false;
+    }
+    return writer->finish();
+}
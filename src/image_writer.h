@@ -0,0 +1,48 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iteration_buffer.h"
+
+enum class ImageFormat
+{
+    PPM,
+    PNG,
+    TIFF // uncompressed, BigTIFF past 4 GB
+};
+
+// Writes 8-bit RGB images a few rows at a time, top row first, so callers
+// never need the whole image in memory
+class ImageWriter
+{
+public:
+    virtual ~ImageWriter() {}
+
+    // `rgb` holds `rows` rows of width * 3 bytes
+    virtual bool writeRows(const uint8_t* rgb, int rows) = 0;
+
+    // Flushes and closes the file; false if anything failed along the way
+    virtual bool finish() = 0;
+};
+
+// By extension: ".png" is PNG, ".tif" or ".tiff" TIFF, anything else PPM
+ImageFormat imageFormatFor(const std::string& path);
+
+// PNG needs zlib at build time; nullptr if it's missing or the file can't be
+// created
+std::unique_ptr<ImageWriter> openImageWriter(const std::string& path, int width, int height);
+std::unique_ptr<ImageWriter> openImageWriter(const std::string& path, int width, int height, ImageFormat format);
+
+// Same grayscale as colorize(), as RGB rows from `first_row` down to
+// `first_row - rows + 1` of the buffer (buffers run bottom up, images top
+// down)
+void grayscaleRows(const IterationBuffer& buffer, int max_iterations, int first_row, int rows, std::vector<uint8_t>& rgb);
+
+// The whole buffer through grayscaleRows()
+bool writeImage(const std::string& path, const IterationBuffer& buffer, int max_iterations);
+
+#endif
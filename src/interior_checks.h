@@ -0,0 +1,93 @@
+#ifndef INTERIOR_CHECKS_H
+#define INTERIOR_CHECKS_H
+
+// Early-outs for pixels inside the set, which would otherwise run all the way
+// to max_iterations. Shared by the CPU kernels and mirrored in the fragment
+// shaders; each can be switched off for benchmarking.
+//
+// - cardioid: closed-form test for the main cardioid and the period-2 bulb
+// - periodicity: Brent cycle detection, saving z at powers of two and
+//   stopping when the orbit returns to it exactly. An exactly repeating orbit
+//   never escapes, so this can't change a result.
+// - derivative: stops once |dz_n/dz_1| has shrunk below a threshold, i.e. the
+//   orbit is being pulled into an attracting cycle. Cheap, but it can cut off
+//   exterior orbits that pass close to 0, so it's off by default.
+
+struct InteriorChecks
+{
+    bool cardioid = true;
+    bool periodicity = true;
+    bool derivative = false;
+
+    unsigned mask() const;
+};
+
+constexpr unsigned INTERIOR_CARDIOID = 1;
+constexpr unsigned INTERIOR_PERIODICITY = 2;
+constexpr unsigned INTERIOR_DERIVATIVE = 4;
+constexpr unsigned INTERIOR_CHECK_COMBINATIONS = 8;
+
+// Squared |dz/dz_1| below which an orbit counts as attracted
+constexpr double INTERIOR_DERIVATIVE_EPSILON = 1e-12;
+
+inline unsigned InteriorChecks::mask() const
+{
+    return (cardioid ? INTERIOR_CARDIOID : 0) | (periodicity ? INTERIOR_PERIODICITY : 0) | (derivative ? INTERIOR_DERIVATIVE : 0);
+}
+
+template <typename T>
+inline bool inMainCardioidOrBulb(T cx, T cy)
+{
+    T x = cx - T(0.25);
+    T yy = cy * cy;
+    T q = x * x + yy;
+    if (q * (q + x) < T(0.25) * yy)
+        return true;
+    return (cx + T(1)) * (cx + T(1)) + yy < T(0.0625);
+}
+
+// iterateMandelbrot() with the checks in CHECKS enabled, in the exact
+// operation order the SIMD kernels use
+template <unsigned CHECKS, typename T>
+inline int iterateMandelbrotChecked(T cx, T cy, int max_iterations)
+{
+    if ((CHECKS & INTERIOR_CARDIOID) && inMainCardioidOrBulb(cx, cy))
+        return max_iterations;
+
+    T x = T(0), y = T(0);
+    T saved_x = T(0), saved_y = T(0);
+    T dx = T(1), dy = T(0);
+    int check_at = 1;
+    int i;
+    for (i = 0; i < max_iterations; i++)
+    {
+        T next_x = x * x - y * y + cx;
+        y = T(2) * x * y + cy;
+        x = next_x;
+        if (x * x + y * y > T(4)) break;
+
+        if (CHECKS & INTERIOR_PERIODICITY)
+        {
+            if (x == saved_x && y == saved_y)
+                return max_iterations;
+            if (i + 1 == check_at)
+            {
+                saved_x = x;
+                saved_y = y;
+                check_at *= 2;
+            }
+        }
+        if (CHECKS & INTERIOR_DERIVATIVE)
+        {
+            // dz_(n+1)/dz_1 is the product of 2 z_k for k = 1..n
+            T next_dx = T(2) * (x * dx - y * dy);
+            dy = T(2) * (x * dy + y * dx);
+            dx = next_dx;
+            if (dx * dx + dy * dy < T(INTERIOR_DERIVATIVE_EPSILON))
+                return max_iterations;
+        }
+    }
+    return i;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef ITERATION_BUFFER_H
+#define ITERATION_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+// Per-pixel escape iteration counts, row-major with row 0 at the bottom so it
+// lines up with gl_FragCoord and glReadPixels. Engines resize it to the view
+// and reuse the storage from frame to frame.
+struct IterationBuffer
+{
+    int width = 0;
+    int height = 0;
+    std::vector<int> iterations;
+
+    void resize(int new_width, int new_height)
+    {
+        width = new_width;
+        height = new_height;
+        iterations.resize((size_t)width * height);
+    }
+
+    int& at(int x, int y) { return iterations[(size_t)y * width + x]; }
+    int at(int x, int y) const { return iterations[(size_t)y * width + x]; }
+};
+
+// RGBA8 grayscale matching the fragment shader's iterations / max_iterations
+inline void colorize(const IterationBuffer& buffer, int max_iterations, std::vector<uint8_t>& rgba)
+{
+    rgba.resize(buffer.iterations.size() * 4);
+    for (size_t i = 0; i < buffer.iterations.size(); i++)
+    {
+        uint8_t value = (uint8_t)(255.0f * buffer.iterations[i] / max_iterations + 0.5f);
+        rgba[i * 4 + 0] = value;
+        rgba[i * 4 + 1] = value;
+        rgba[i * 4 + 2] = value;
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+#endif
@@ -0,0 +1,408 @@
+#include "job_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef LEIBNIZ_HAVE_EGL
+#include "egl_context.h"
+#endif
+#include "image_writer.h"
+#include "raw_iterations.h"
+#include "strip_renderer.h"
+
+namespace
+{
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string describeSize(const RenderJob& job)
+{
+    return std::string(FRACTALS.at(job.view.fractal)) + " " + std::to_string(job.view.width) + "x"
+        + std::to_string(job.view.height);
+}
+
+// Renders one job and writes its files; `message` says how it went
+bool runJob(JobRenderer& renderer, const RenderJob& job, std::string& message)
+{
+    if (job.streams())
+    {
+        if (job.engine != EngineType::CPU)
+        {
+            message = "strips and supersampling need the CPU engine";
+            return false;
+        }
+        std::unique_ptr<ImageWriter> writer = openImageWriter(job.output, job.view.width, job.view.height);
+        if (!writer)
+        {
+            message = "couldn't write " + job.output;
+            return false;
+        }
+        StripRenderOptions options;
+        options.strip_rows = job.strip_rows;
+        options.supersample = job.supersample;
+        options.adaptive_samples = job.adaptive_samples;
+        options.fill = job.fill;
+        options.interior = job.interior;
+        StripRenderStats stats;
+        if (!renderStrips(job.view, *writer, options, &stats, renderer.tileScheduler()))
+        {
+            message = "couldn't render or write " + job.output;
+            return false;
+        }
+        message = describeSize(job) + ", " + std::to_string(stats.strips) + " strips";
+        return true;
+    }
+
+    IterationBuffer buffer;
+    std::string detail;
+    PrecisionTier tier = PrecisionTier::CPU_DOUBLE;
+    if (!renderer.render(job, buffer, detail, tier))
+    {
+        message = std::string(ENGINES.at(job.engine)) + " engine can't render this view (" + detail + ")";
+        return false;
+    }
+    if (!writeImage(job.output, buffer, job.view.max_iterations))
+    {
+        message = "couldn't write " + job.output;
+        return false;
+    }
+    if (!job.raw.empty())
+    {
+        EscapeChannels channels;
+        bool escape = computeEscapeChannels(job.view, buffer, channels);
+        if (!writeRawIterations(job.raw, job.view, tier, buffer, escape ? &channels : nullptr))
+        {
+            message = "couldn't write " + job.raw;
+            return false;
+        }
+    }
+    message = describeSize(job) + ", " + ENGINES.at(job.engine) + " (" + detail + ")";
+    return true;
+}
+
+// Jobs that have to go through the renderer owning the GL context
+bool needsContext(const RenderJob& job, bool have_gl)
+{
+    return job.engine == EngineType::GPU || job.engine == EngineType::HYBRID
+        || (job.engine == EngineType::AUTO && have_gl && !job.streams());
+}
+
+}
+
+JobRenderer::JobRenderer(std::shared_ptr<TileScheduler> scheduler, std::shared_ptr<ReferenceCache> references)
+    : scheduler(scheduler ? scheduler : std::make_shared<TileScheduler>()), references(references)
+{
+}
+
+JobRenderer::~JobRenderer()
+{
+    // GL objects go while the context is still current
+    hybrid_engine.reset();
+    gl_engine.reset();
+    auto_engine.reset();
+}
+
+bool JobRenderer::glAvailable()
+{
+#ifdef LEIBNIZ_HAVE_EGL
+    if (!gl_tried)
+    {
+        gl_tried = true;
+        context.reset(new EglContext());
+        if (!context->valid())
+        {
+            gl_error = "no GL context: " + context->error();
+            context.reset();
+        }
+    }
+    return context != nullptr;
+#else
+    gl_error = "needs a GL context, and this build has no EGL";
+    return false;
+#endif
+}
+
+bool JobRenderer::render(const RenderJob& job, IterationBuffer& buffer, std::string& detail, PrecisionTier& tier)
+{
+    // The GPU engines get the windowless context; auto goes without the GPU
+    // when there isn't one
+    bool have_gl = false;
+    if (job.engine == EngineType::GPU || job.engine == EngineType::HYBRID || job.engine == EngineType::AUTO)
+    {
+        have_gl = glAvailable();
+        if (!have_gl && job.engine != EngineType::AUTO)
+        {
+            detail = gl_error;
+            return false;
+        }
+        // Programs from another directory mean new engines
+        if (job.shader_directory != gl_shader_directory)
+        {
+            hybrid_engine.reset();
+            gl_engine.reset();
+            auto_engine.reset();
+            gl_shader_directory = job.shader_directory;
+        }
+    }
+
+    switch (job.engine)
+    {
+        case EngineType::CPU:
+        {
+            if (!cpu_engine)
+                cpu_engine.reset(new CpuEngine(scheduler));
+            cpu_engine->fill = job.fill;
+            cpu_engine->interior = job.interior;
+            bool rendered = cpu_engine->render(job.view, buffer);
+            detail = CPU_PRECISIONS.at(cpu_engine->lastPrecision());
+            tier = cpuPrecisionTier(cpu_engine->lastPrecision());
+            return rendered;
+        }
+        case EngineType::PERTURBATION:
+        {
+            if (!perturbation_engine)
+            {
+                perturbation_engine.reset(new PerturbationEngine(scheduler));
+                perturbation_engine->references = references;
+            }
+            bool rendered = perturbation_engine->render(job.view, buffer);
+            detail = std::to_string(perturbation_engine->lastStats().references) + " references";
+            if (perturbation_engine->lastReferenceCached())
+                detail += ", primary reused";
+            tier = PrecisionTier::PERTURBATION;
+            return rendered;
+        }
+        case EngineType::AUTO:
+        {
+            if (!auto_engine)
+            {
+                auto_engine.reset(new AutoEngine(have_gl, scheduler));
+                auto_engine->shader_directory = job.shader_directory;
+                auto_engine->references = references;
+            }
+            auto_engine->interior = job.interior;
+            bool rendered = auto_engine->render(job.view, buffer);
+            detail = PRECISION_TIERS.at(auto_engine->lastTier());
+            tier = auto_engine->lastTier();
+            return rendered;
+        }
+#ifdef LEIBNIZ_HAVE_EGL
+        case EngineType::GPU:
+        {
+            if (!gl_engine)
+                gl_engine.reset(new GlEngine(job.shader_directory));
+            gl_engine->interior = job.interior;
+            bool rendered = gl_engine->render(job.view, buffer);
+            detail = "GL 4." + std::to_string(context->minorVersion());
+            tier = PrecisionTier::GPU_FLOAT;
+            return rendered;
+        }
+        case EngineType::HYBRID:
+        {
+            if (!hybrid_engine)
+                hybrid_engine.reset(new HybridEngine(scheduler, job.shader_directory));
+            hybrid_engine->setInterior(job.interior);
+            hybrid_engine->cpu().fill = job.fill;
+            bool rendered = hybrid_engine->render(job.view, buffer);
+            detail = std::to_string(hybrid_engine->lastGpuRows()) + " rows on the GPU";
+            tier = PrecisionTier::GPU_FLOAT; // the least precise rows
+            return rendered;
+        }
+#endif
+        default:
+            detail = "needs a GL context, and this build has no EGL";
+            return false;
+    }
+}
+
+bool parseJobFile(const std::string& path, const RenderJob& defaults, std::vector<RenderJob>& jobs, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "can't read " + path;
+        return false;
+    }
+
+    jobs.clear();
+    std::unordered_map<std::string, int> output_lines;
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++)
+    {
+        std::string where = path + ":" + std::to_string(line_number) + ": ";
+        std::istringstream tokens(line);
+        std::string token;
+        if (!(tokens >> token) || token[0] == '#')
+            continue;
+
+        RenderJob job = defaults;
+        do
+        {
+            size_t equals = token.find('=');
+            std::string option_error;
+            if (equals == std::string::npos || equals == 0)
+            {
+                error = where + "expected key=value, not '" + token + "'";
+                return false;
+            }
+            if (!applyRenderOption(job, token.substr(0, equals), token.substr(equals + 1), option_error))
+            {
+                error = where + option_error;
+                return false;
+            }
+        } while (tokens >> token);
+
+        if (job.video || !job.checkpoint.empty() || !job.from_raw.empty() || job.processes != 1 || job.output == "-")
+        {
+            error = where + "videos, checkpoints, from-raw, processes and stdout are for single renders";
+            return false;
+        }
+        if (job.supersample > 1 && job.adaptive_samples > 1)
+        {
+            error = where + "supersample and adaptive-samples are alternatives; pick one";
+            return false;
+        }
+        if (!job.raw.empty() && job.streams())
+        {
+            error = where + "raw files hold one frame's buffer, so no strips or supersampling";
+            return false;
+        }
+        auto earlier = output_lines.find(job.output);
+        if (earlier != output_lines.end())
+        {
+            error = where + job.output + " is already the output of line " + std::to_string(earlier->second);
+            return false;
+        }
+        output_lines[job.output] = line_number;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+bool renderBatch(const std::vector<RenderJob>& jobs, const BatchOptions& options, BatchStats* stats,
+                 const std::function<void(const BatchJobReport&)>& report)
+{
+    auto start = std::chrono::steady_clock::now();
+    BatchStats local_stats;
+    BatchStats& result = stats ? *stats : local_stats;
+    result = BatchStats();
+    result.jobs = (int)jobs.size();
+
+    auto scheduler = std::make_shared<TileScheduler>();
+    auto references = std::make_shared<ReferenceCache>(options.reference_cache);
+
+    // Biggest first, so the small ones pack in around them at the end
+    std::vector<size_t> pending(jobs.size());
+    std::vector<double> cost(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const RenderJob& job = jobs[i];
+        int samples = std::max(job.supersample, 1);
+        pending[i] = i;
+        cost[i] = (double)job.view.width * job.view.height * job.view.max_iterations * samples * samples;
+    }
+    std::stable_sort(pending.begin(), pending.end(), [&](size_t a, size_t b) { return cost[a] > cost[b]; });
+
+    // Jobs that would compute the same primary reference, which run one
+    // after another so the later ones find it cached
+    std::vector<std::string> reference_keys(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const View& view = jobs[i].view;
+        if (jobs[i].engine == EngineType::PERTURBATION || jobs[i].engine == EngineType::AUTO)
+            reference_keys[i] = std::to_string((int)view.fractal) + " " + view.center_x + " " + view.center_y + " "
+                + formatFloatExp(view.zoom) + " " + std::to_string(view.max_iterations);
+    }
+
+    bool maybe_gl = std::any_of(jobs.begin(), jobs.end(), [](const RenderJob& job) { return needsContext(job, true); });
+    std::mutex mutex;
+    std::condition_variable changed; // the GL context was tried, or a job finished
+    int gl_state = maybe_gl ? -1 : 0; // unknown until the first lane has tried
+    std::unordered_multiset<std::string> keys_in_flight;
+    std::mutex report_mutex;
+
+    auto lane = [&](int index)
+    {
+        JobRenderer renderer(scheduler, references);
+        if (index == 0 && gl_state < 0)
+        {
+            bool have_gl = renderer.glAvailable();
+            std::lock_guard<std::mutex> lock(mutex);
+            gl_state = have_gl ? 1 : 0;
+            changed.notify_all();
+        }
+
+        while (true)
+        {
+            // The first lane takes the next job whatever it is; the others
+            // the next one that doesn't need its context. Jobs waiting on a
+            // reference in flight go last, and wait only if nothing else can
+            // run.
+            size_t job_index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return gl_state >= 0; });
+                auto runnable = [&](size_t i) { return index == 0 || !needsContext(jobs[i], gl_state == 1); };
+                auto next = pending.end();
+                while (true)
+                {
+                    next = std::find_if(pending.begin(), pending.end(), [&](size_t i)
+                    {
+                        return runnable(i) && (reference_keys[i].empty() || !keys_in_flight.count(reference_keys[i]));
+                    });
+                    if (next != pending.end() || std::none_of(pending.begin(), pending.end(), runnable))
+                        break;
+                    changed.wait(lock);
+                }
+                if (next == pending.end())
+                    return;
+                job_index = *next;
+                pending.erase(next);
+                if (!reference_keys[job_index].empty())
+                    keys_in_flight.insert(reference_keys[job_index]);
+            }
+
+            auto job_start = std::chrono::steady_clock::now();
+            BatchJobReport job_report;
+            job_report.index = job_index;
+            job_report.ok = runJob(renderer, jobs[job_index], job_report.message);
+            job_report.seconds = secondsSince(job_start);
+
+            if (!reference_keys[job_index].empty())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                keys_in_flight.erase(keys_in_flight.find(reference_keys[job_index]));
+                changed.notify_all();
+            }
+            std::lock_guard<std::mutex> lock(report_mutex);
+            if (!job_report.ok)
+                result.failed++;
+            if (report)
+                report(job_report);
+        }
+    };
+
+    int lanes = std::max(1, std::min(options.concurrent_jobs, (int)jobs.size()));
+    std::vector<std::thread> threads;
+    for (int index = 1; index < lanes; index++)
+        threads.emplace_back(lane, index);
+    // The calling thread is the first lane, so a GL context stays on it
+    lane(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    result.reference_hits = references->hits();
+    result.reference_misses = references->misses();
+    result.seconds = secondsSince(start);
+    return result.failed == 0;
+}
@@ -0,0 +1,114 @@
+#ifndef JOB_RENDERER_H
+#define JOB_RENDERER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "auto_engine.h"
+#include "cpu_engine.h"
+#include "gl_engine.h"
+#include "hybrid_engine.h"
+#include "iteration_buffer.h"
+#include "perturbation_engine.h"
+#include "precision_planner.h"
+#include "render_options.h"
+#include "tile_scheduler.h"
+
+#ifdef LEIBNIZ_HAVE_EGL
+class EglContext;
+#endif
+
+// Renders jobs one after another with whichever engine each names, keeping
+// the engines between jobs: compiled GL programs, the auto engine's measured
+// costs and the CPU engine's scratch all stay warm. Renderers can share a
+// tile pool and a reference cache. Each one belongs to the thread that first
+// renders with it, which also owns its GL context.
+class JobRenderer
+{
+public:
+    explicit JobRenderer(std::shared_ptr<TileScheduler> scheduler = nullptr,
+                         std::shared_ptr<ReferenceCache> references = nullptr);
+    ~JobRenderer();
+
+    JobRenderer(const JobRenderer&) = delete;
+    JobRenderer& operator=(const JobRenderer&) = delete;
+
+    // Makes the windowless GL context the first time; false if there can't
+    // be one, with the reason in glError()
+    bool glAvailable();
+    const std::string& glError() const { return gl_error; }
+
+    // Renders job.view into `buffer`. `detail` says how, or why it couldn't,
+    // and `tier` what the counts were computed in. Jobs that need several
+    // processes aren't this class's business.
+    bool render(const RenderJob& job, IterationBuffer& buffer, std::string& detail, PrecisionTier& tier);
+
+    const std::shared_ptr<TileScheduler>& tileScheduler() const { return scheduler; }
+
+private:
+    // The context outlives the engines holding GL objects
+#ifdef LEIBNIZ_HAVE_EGL
+    std::unique_ptr<EglContext> context;
+#endif
+    bool gl_tried = false;
+    std::string gl_error;
+    std::shared_ptr<TileScheduler> scheduler;
+    std::shared_ptr<ReferenceCache> references;
+    std::unique_ptr<CpuEngine> cpu_engine;
+    std::unique_ptr<PerturbationEngine> perturbation_engine;
+    std::unique_ptr<AutoEngine> auto_engine;
+    std::unique_ptr<GlEngine> gl_engine;
+    std::unique_ptr<HybridEngine> hybrid_engine;
+    std::string gl_shader_directory; // the GL engines' programs come from here
+};
+
+// Job files list one render per line as key=value settings with the keys of
+// applyRenderOption(), starting from `defaults`:
+//
+//   # a thumbnail and a poster of the same spiral
+//   center-x=-0.743643887037 center-y=0.131825904205 zoom=1e-9 width=320 height=180 output=thumb.png
+//   center-x=-0.743643887037 center-y=0.131825904205 zoom=1e-9 width=7680 height=4320 output=poster.tif
+//
+// Blank lines and lines starting with # are skipped. Values can't hold
+// spaces. Every job needs an output of its own; videos, checkpoints, raw
+// input, stdout and worker processes stay with single renders.
+bool parseJobFile(const std::string& path, const RenderJob& defaults, std::vector<RenderJob>& jobs, std::string& error);
+
+struct BatchOptions
+{
+    int concurrent_jobs = 2; // jobs in flight, all on one tile pool
+    size_t reference_cache = 8; // primary references kept for later jobs
+};
+
+struct BatchJobReport
+{
+    size_t index; // into the job list
+    bool ok;
+    std::string message; // what was rendered and how, or what went wrong
+    double seconds;      // render and write
+};
+
+struct BatchStats
+{
+    int jobs = 0;
+    int failed = 0;
+    int reference_hits = 0;
+    int reference_misses = 0;
+    double seconds = 0.0;
+};
+
+// Renders and writes every job in this one process. Each job in flight has a
+// JobRenderer of its own, and they all share one tile pool and one reference
+// cache. The biggest jobs (pixels times iterations) start first and the small
+// ones fill in around them, so a small job's serial parts (reference orbits,
+// compressing its image) overlap a big job's tiles. GPU jobs, and auto jobs
+// when there's a GL context, all go through the first renderer, which owns
+// the context. `report` is called as each job finishes, from its thread but
+// never from two threads at once. False if any job failed.
+bool renderBatch(const std::vector<RenderJob>& jobs, const BatchOptions& options, BatchStats* stats = nullptr,
+                 const std::function<void(const BatchJobReport&)>& report = nullptr);
+
+#endif
@@ -1,7 +1,15 @@
 #include <iostream>
 #include <cstdio>
+#include <cstdint>
 #include <string>
 #include <cmath>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "imgui.h"
 #include "imgui_internal.h"
@@ -13,7 +21,12 @@
 #include "fractals.h"
 #include "version.h"
 #include "window_title.h"
-#include "shader_loader.h"
+#include "auto_engine.h"
+#include "engine.h"
+#include "render_thread.h"
+#include "gl_engine.h"
+#include "cpu_engine.h"
+#include "nucleus.h"
 
 // UI parameters
 constexpr float CONTROL_COL_WIDTH = 0.2f;
@@ -23,18 +36,37 @@ ImVec2 display_col_pos;
 ImVec2 display_col_size;
 
 // State variables
-Fractal selected_fractal = Fractal::MANDELBROT;
-ImVec2 fractal_pos = ImVec2(0.0, 0.0);
-float fractal_zoom = 2.0;
+View view;
+EngineType selected_engine = EngineType::GPU;
+std::unordered_map<EngineType, std::unique_ptr<Engine>> engines;
 ImVec2 last_mouse_pos;
 bool rendering = false;
+int minibrot_period = -1; // Result of the last minibrot search; 0 if none found
+// Deep in, the minibrot search takes seconds, so it runs off the UI thread;
+// the view only moves to its result if nothing else moved it meanwhile
+std::future<Nucleus> minibrot_search;
+std::atomic<bool> minibrot_cancel(false);
+View minibrot_view;
+InteriorChecks interior_checks;
+TileFill tile_fill = TileFill::FULL;
+
+// CPU-side engines render off the UI thread; the last frame they finished
+// stays on screen until the next one arrives
+std::unique_ptr<RenderThread> render_thread;
+View submitted_view;
+EngineType submitted_engine = EngineType::GPU;
+TileFill submitted_fill = TileFill::FULL;
+std::vector<uint8_t> render_pixels;
+GLuint render_texture = 0;
 
-void renderFractal(const char* name);
 void adjustFractalZoom(GLFWwindow* window, double xoffset, double y_offset);
 void renderControlColumn();
 void renderSelectedFractal();
 void moveCursorPos(float deltaX, float deltaY);
-void checkCompileErrors(GLuint shader, std::string type);
+void zoomToMinibrot();
+void finishMinibrotSearch();
+Engine& engineFor(EngineType type);
+void renderStatusOverlay(ImVec2 render_pos);
 
 int main()
 {
@@ -66,6 +98,15 @@ int main()
 
     glfwSetScrollCallback(window, adjustFractalZoom);
 
+    // A hidden window's context, sharing this one's objects, lets the render
+    // thread use the GPU too
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* render_context = glfwCreateWindow(1, 1, "", NULL, window);
+    std::function<void()> attach_context;
+    if (render_context)
+        attach_context = [render_context] { glfwMakeContextCurrent(render_context); };
+    render_thread.reset(new RenderThread(attach_context));
+
     while (!glfwWindowShouldClose(window))
     {
         glfwPollEvents();
@@ -74,10 +115,11 @@ int main()
         ImVec2 mousePos = ImGui::GetMousePos();
         if (ImGui::IsMouseDown(ImGuiMouseButton_Left))
         {
-            if (mousePos.x > display_w * CONTROL_COL_WIDTH)
+            bool moved = mousePos.x != last_mouse_pos.x || mousePos.y != last_mouse_pos.y;
+            if (mousePos.x > display_w * CONTROL_COL_WIDTH && moved)
             {
-                fractal_pos.x -= (0.0005 * fractal_zoom) * (mousePos.x - last_mouse_pos.x);
-                fractal_pos.y += (0.0005 * fractal_zoom) * (mousePos.y - last_mouse_pos.y);
+                view.offsetCenter(floatexp(-0.0005 * (mousePos.x - last_mouse_pos.x)) * view.zoom,
+                                  floatexp(0.0005 * (mousePos.y - last_mouse_pos.y)) * view.zoom);
             }
         }
         last_mouse_pos = mousePos;
@@ -114,6 +156,7 @@ int main()
         display_col_pos = ImGui::GetCursorScreenPos();
         display_col_size = ImGui::GetContentRegionAvail();
 
+        finishMinibrotSearch();
         if (rendering)
             renderSelectedFractal();
 
@@ -127,6 +170,18 @@ int main()
         glfwSwapBuffers(window);
     }
 
+    minibrot_cancel = true;
+    if (minibrot_search.valid())
+        minibrot_search.wait();
+
+    // Engines own GL objects, so they go before the context does
+    render_thread.reset();
+    if (render_context)
+        glfwDestroyWindow(render_context);
+    engines.clear();
+    if (render_texture)
+        glDeleteTextures(1, &render_texture);
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -137,88 +192,12 @@ int main()
     return 0;
 }
 
-void renderFractal(const char* name)
-{
-    // Shader stuff
-    //
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Load and compile vertex shader
-    char vertex_shader_name[64];
-    std::sprintf(vertex_shader_name, "../shaders/%s/vertex_shader.glsl", name);
-    std::string vertex_shader_source_string = loadShaderSource(vertex_shader_name);
-    const char* vertex_shader_source = vertex_shader_source_string.c_str();
-    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-    glCompileShader(vertex_shader);
-    checkCompileErrors(vertex_shader, "VERTEX");
-
-    // Load and compile fragment shader
-    char fragmentShaderName[64];
-    std::sprintf(fragmentShaderName, "../shaders/%s/fragment_shader.glsl", name);
-    std::string fragmentShaderSourceString = loadShaderSource(fragmentShaderName);
-    const char* fragmentShaderSource = fragmentShaderSourceString.c_str();
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    checkCompileErrors(fragmentShader, "FRAGMENT");
-
-    // Link shaders to program
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragmentShader);
-    glLinkProgram(shader_program);
-    checkCompileErrors(shader_program, "PROGRAM");
-
-    // Clean up shaders; they're linked to the program now
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragmentShader);
-
-    float vertices[] = { // goofy
-        -1.0f, -1.0f,
-         1.0f, -1.0f,
-        -1.0f,  1.0f,
-         1.0f,  1.0f
-    };
-
-    GLuint VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    int padding = 20;
-    ImVec2 render_size = ImVec2(display_col_size.x - 2 * padding,
-                               display_col_size.y - 2 * padding);
-    ImVec2 render_pos = ImVec2(display_col_pos.x + padding,
-                               display_col_pos.y + padding);
-    ImGui::SetCursorScreenPos(render_pos);
-    ImGui::InvisibleButton("##empty", render_size);
-
-    glViewport(render_pos.x, render_pos.y, render_size.x, render_size.y);
-    glEnable(GL_SCISSOR_TEST);
-    glScissor(render_pos.x, render_pos.y, render_size.x, render_size.y);
-
-    // Use the shader program and update uniforms
-    glUseProgram(shader_program);
-    glUniform2f(glGetUniformLocation(shader_program, "u_resolution"), render_size.x, render_size.y);
-    glUniform2f(glGetUniformLocation(shader_program, "u_center"), fractal_pos.x, fractal_pos.y);
-    glUniform1f(glGetUniformLocation(shader_program, "u_zoom"), fractal_zoom);
-
-    // Draw quad
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glDisable(GL_SCISSOR_TEST);
-}
-
 void adjustFractalZoom(GLFWwindow* window, double xoffset, double y_offset)
 {
     if (y_offset == 1)
-        fractal_zoom *= zoom_sensitivity; // Zoom in
+        view.zoom *= floatexp(zoom_sensitivity); // Zoom in
     else if (y_offset == -1)
-        fractal_zoom *= (1 + zoom_sensitivity); // Zoom out
+        view.zoom *= floatexp(1 + zoom_sensitivity); // Zoom out
 }
 
 void renderControlColumn()
@@ -236,13 +215,47 @@ void renderControlColumn()
     {
         for (const auto& pair : FRACTALS)
             if (ImGui::MenuItem(pair.second)) // fractal name
-                selected_fractal = pair.first; // fractal enum
+                view.fractal = pair.first; // fractal enum
+
+        ImGui::EndMenu();
+    }
+
+    moveCursorPos(10, 10);
+    ImGui::Text("Selected: %s", FRACTALS.at(view.fractal));
+
+    moveCursorPos(-10, 10);
+    if (ImGui::BeginMenu("Engines"))
+    {
+        for (const auto& pair : ENGINES)
+            if (ImGui::MenuItem(pair.second)) // engine name
+                selected_engine = pair.first; // engine enum
 
         ImGui::EndMenu();
     }
 
     moveCursorPos(10, 10);
-    ImGui::Text("Selected: %s", FRACTALS.at(selected_fractal));
+    ImGui::Text("Engine: %s", ENGINES.at(selected_engine));
+    if (selected_engine == EngineType::CPU || selected_engine == EngineType::HYBRID)
+    {
+        moveCursorPos(-10, 10);
+        if (ImGui::BeginMenu("Fill"))
+        {
+            for (const auto& pair : TILE_FILLS)
+                if (ImGui::MenuItem(pair.second))
+                    tile_fill = pair.first;
+
+            ImGui::EndMenu();
+        }
+
+        moveCursorPos(10, 10);
+        ImGui::Text("Fill: %s", TILE_FILLS.at(tile_fill));
+    }
+
+    moveCursorPos(-10, 20);
+    ImGui::Text("Interior checks");
+    ImGui::Checkbox("Cardioid/bulb", &interior_checks.cardioid);
+    ImGui::Checkbox("Periodicity", &interior_checks.periodicity);
+    ImGui::Checkbox("Derivative", &interior_checks.derivative);
 
     moveCursorPos(0, 20);
     float button_width = ImGui::CalcTextSize("Render").x + ImGui::GetStyle().FramePadding.x * 2;
@@ -253,49 +266,182 @@ void renderControlColumn()
         rendering = true;
         renderSelectedFractal();
     }
+
+    moveCursorPos(0, 10);
+    button_width = ImGui::CalcTextSize("Zoom to minibrot").x + ImGui::GetStyle().FramePadding.x * 2;
+    offset_x = (ImGui::GetColumnWidth() - button_width) * 0.5;
+    ImGui::SetCursorPosX(ImGui::GetCursorPosX() + offset_x);
+    if (ImGui::Button("Zoom to minibrot") && !minibrot_search.valid())
+        zoomToMinibrot();
+
+    if (minibrot_search.valid())
+        ImGui::Text("Searching for a minibrot...");
+    else if (minibrot_period > 0)
+        ImGui::Text("Minibrot period: %d", minibrot_period);
+    else if (minibrot_period == 0)
+        ImGui::Text("No minibrot in view");
 }
 
-void renderSelectedFractal()
+void zoomToMinibrot()
 {
-    switch (selected_fractal)
+    // Search the disk around the whole view
+    minibrot_view = view;
+    minibrot_search = std::async(std::launch::async, [](View start)
     {
-        case Fractal::MANDELBROT:
-            renderFractal("mandelbrot");
-            break;
-        default:
-            renderFractal("mandelbrot");
-            break;
-    }
+        return findNucleus(start.center_x, start.center_y, start.zoom * floatexp(0.7071), start.max_iterations,
+                           &minibrot_cancel);
+    }, view);
 }
 
-void moveCursorPos(float deltaX, float deltaY)
+void finishMinibrotSearch()
 {
-    auto cursor_pos = ImGui::GetCursorPos();
-    cursor_pos.x += deltaX;
-    cursor_pos.y += deltaY;
-    ImGui::SetCursorPos(cursor_pos);
+    if (!minibrot_search.valid() || minibrot_search.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    Nucleus nucleus = minibrot_search.get();
+    bool moved = view.center_x != minibrot_view.center_x || view.center_y != minibrot_view.center_y
+        || view.zoom.mantissa != minibrot_view.zoom.mantissa || view.zoom.exponent != minibrot_view.zoom.exponent
+        || view.max_iterations != minibrot_view.max_iterations;
+    if (moved)
+        return;
+    minibrot_period = nucleus.found ? nucleus.period : 0;
+    if (!nucleus.found)
+        return;
+
+    view.center_x = nucleus.center_x;
+    view.center_y = nucleus.center_y;
+    view.zoom = nucleus.size * floatexp(4.0);
+    rendering = true;
 }
 
-void checkCompileErrors(GLuint shader, std::string type)
+Engine& engineFor(EngineType type)
 {
-    GLint success;
-    GLchar info_log[1024];
-    if (type != "PROGRAM")
+    std::unique_ptr<Engine>& engine = engines[type];
+    if (!engine)
+        engine = createEngine(type);
+    return *engine;
+}
+
+void renderSelectedFractal()
+{
+    int padding = 20;
+    ImVec2 render_size = ImVec2(display_col_size.x - 2 * padding,
+                               display_col_size.y - 2 * padding);
+    ImVec2 render_pos = ImVec2(display_col_pos.x + padding,
+                               display_col_pos.y + padding);
+    ImGui::SetCursorScreenPos(render_pos);
+
+    view.width = (int)render_size.x;
+    view.height = (int)render_size.y;
+    if (view.width <= 0 || view.height <= 0)
+        return;
+
+    // GL's window origin is the bottom left corner
+    int window_height = (int)ImGui::GetIO().DisplaySize.y;
+    int gl_x = (int)render_pos.x, gl_y = window_height - (int)(render_pos.y + render_size.y);
+    if (selected_engine == EngineType::GPU)
+    {
+        ImGui::InvisibleButton("##empty", render_size);
+        GlEngine& gl_engine = static_cast<GlEngine&>(engineFor(EngineType::GPU));
+        gl_engine.interior = interior_checks;
+        gl_engine.draw(view, gl_x, gl_y);
+        return;
+    }
+
+    if (selected_engine == EngineType::AUTO)
+    {
+        // Shallow views stay on the GPU; the planner decides when to leave
+        AutoEngine& auto_engine = static_cast<AutoEngine&>(engineFor(EngineType::AUTO));
+        auto_engine.interior = interior_checks;
+        if (auto_engine.draw(view, gl_x, gl_y))
+        {
+            ImGui::InvisibleButton("##empty", render_size);
+            renderStatusOverlay(render_pos);
+            return;
+        }
+    }
+
+    if (view != submitted_view || selected_engine != submitted_engine || tile_fill != submitted_fill)
+    {
+        // Tiles under the cursor come first; buffer rows run bottom up. A
+        // new request cancels the frame still in progress.
+        ImVec2 mouse = ImGui::GetMousePos();
+        bool hovered = ImGui::IsMouseHoveringRect(render_pos, ImVec2(render_pos.x + render_size.x, render_pos.y + render_size.y));
+        RenderRequest request;
+        request.view = view;
+        request.engine = selected_engine;
+        request.interior = interior_checks;
+        request.fill = tile_fill;
+        request.focus_x = hovered ? mouse.x - render_pos.x : -1.0;
+        request.focus_y = hovered ? render_pos.y + render_size.y - mouse.y : -1.0;
+        render_thread->submit(request);
+        submitted_view = view;
+        submitted_engine = selected_engine;
+        submitted_fill = tile_fill;
+    }
+
+    if (render_thread->update())
     {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success)
+        const RenderedFrame& frame = render_thread->frame();
+        // The UI's planner decides when to leave the GPU, so it needs the
+        // CPU tiers' costs from the render thread too
+        if (frame.request.engine == EngineType::AUTO)
         {
-            glGetShaderInfoLog(shader, 1024, NULL, info_log);
-            std::cerr << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << info_log << "\n -- --------------------------------------------------- -- " << std::endl;
+            AutoEngine& auto_engine = static_cast<AutoEngine&>(engineFor(EngineType::AUTO));
+            auto_engine.planner.recordFrame(frame.tier, frame.request.view, frame.seconds);
         }
+        colorize(frame.buffer, frame.request.view.max_iterations, render_pixels);
+
+        if (!render_texture)
+            glGenTextures(1, &render_texture);
+        glBindTexture(GL_TEXTURE_2D, render_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, frame.buffer.width, frame.buffer.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, render_pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
     }
+
+    // Buffer rows run bottom up, so flip the texture vertically. Until the
+    // first frame arrives there's nothing to show.
+    if (render_texture)
+        ImGui::Image((ImTextureID)(intptr_t)render_texture, render_size, ImVec2(0, 1), ImVec2(1, 0));
     else
+        ImGui::InvisibleButton("##empty", render_size);
+    renderStatusOverlay(render_pos);
+}
+
+void renderStatusOverlay(ImVec2 render_pos)
+{
+    // What the shown frame was rendered with, in the render area's corner
+    ImGui::SetCursorScreenPos(ImVec2(render_pos.x + 10, render_pos.y + 10));
+    if (selected_engine == EngineType::AUTO)
     {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success)
+        AutoEngine& auto_engine = static_cast<AutoEngine&>(engineFor(EngineType::AUTO));
+        PrecisionTier tier = auto_engine.planner.current();
+        if (tier == PrecisionTier::GPU_FLOAT)
         {
-            glGetProgramInfoLog(shader, 1024, NULL, info_log);
-            std::cerr << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << info_log << "\n -- --------------------------------------------------- -- " << std::endl;
+            // Timer queries lag a few frames behind; until one is back
+            // there's only the planner's guess
+            if (auto_engine.drawThroughput() > 0.0)
+                ImGui::Text("%s, %.1f Mpixel/s", PRECISION_TIERS.at(tier), auto_engine.drawThroughput() * 1e-6);
+            else
+                ImGui::Text("%s, %.1f Mpixel/s (estimate)", PRECISION_TIERS.at(tier),
+                            auto_engine.planner.expectedThroughput(tier, view) * 1e-6);
+            return;
         }
     }
+
+    if (!render_texture)
+        return;
+    const RenderedFrame& frame = render_thread->frame();
+    double throughput = frame.seconds > 0.0 ? frame.buffer.width * (double)frame.buffer.height / frame.seconds : 0.0;
+    ImGui::Text("%s, %.1f Mpixel/s%s", frame.precision.c_str(), throughput * 1e-6, render_thread->busy() ? " (rendering)" : "");
+}
+
+void moveCursorPos(float deltaX, float deltaY)
+{
+    auto cursor_pos = ImGui::GetCursorPos();
+    cursor_pos.x += deltaX;
+    cursor_pos.y += deltaY;
+    ImGui::SetCursorPos(cursor_pos);
 }
@@ -0,0 +1,605 @@
+#ifndef MP_REAL_H
+#define MP_REAL_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "floatexp.h"
+
+// Fixed-size multiprecision arithmetic for reference orbits. Everything the
+// Mandelbrot iteration touches stays well inside |x| < 2^63, so a MpReal<N>
+// is plain fixed point: N 64-bit limbs of two's complement, least significant
+// first, with the top limb holding the integer part. That keeps add/sub to a
+// single carry chain and lets every size live on the stack.
+
+namespace mp
+{
+
+typedef uint64_t Limb;
+typedef unsigned __int128 Wide;
+
+// Below this many limbs schoolbook multiplication beats Karatsuba
+constexpr int KARATSUBA_THRESHOLD = 24;
+
+// From this many limbs on, x^2, y^2 and xy of an orbit step are worth
+// handing to separate threads
+constexpr int PARALLEL_PRODUCT_LIMBS = 16;
+
+inline Limb add(Limb* r, const Limb* a, const Limb* b, int n)
+{
+    Limb carry = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Wide sum = (Wide)a[i] + b[i] + carry;
+        r[i] = (Limb)sum;
+        carry = (Limb)(sum >> 64);
+    }
+    return carry;
+}
+
+inline Limb sub(Limb* r, const Limb* a, const Limb* b, int n)
+{
+    Limb borrow = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Wide diff = (Wide)a[i] - b[i] - borrow;
+        r[i] = (Limb)diff;
+        borrow = (Limb)(diff >> 64) & 1;
+    }
+    return borrow;
+}
+
+// r[0..rn) += a[0..an), an <= rn
+inline void addInto(Limb* r, int rn, const Limb* a, int an)
+{
+    Limb carry = 0;
+    int i = 0;
+    for (; i < an; i++)
+    {
+        Wide sum = (Wide)r[i] + a[i] + carry;
+        r[i] = (Limb)sum;
+        carry = (Limb)(sum >> 64);
+    }
+    for (; carry && i < rn; i++)
+        carry = ++r[i] == 0;
+}
+
+// r[0..rn) -= a[0..an), an <= rn
+inline void subFrom(Limb* r, int rn, const Limb* a, int an)
+{
+    Limb borrow = 0;
+    int i = 0;
+    for (; i < an; i++)
+    {
+        Wide diff = (Wide)r[i] - a[i] - borrow;
+        r[i] = (Limb)diff;
+        borrow = (Limb)(diff >> 64) & 1;
+    }
+    for (; borrow && i < rn; i++)
+        borrow = r[i]-- == 0;
+}
+
+inline void negate(Limb* r, int n)
+{
+    Limb carry = 1;
+    for (int i = 0; i < n; i++)
+    {
+        Wide sum = (Wide)(~r[i]) + carry;
+        r[i] = (Limb)sum;
+        carry = (Limb)(sum >> 64);
+    }
+}
+
+// r[0..2n) = a * b. Partial products landing below limb `skip` are left out;
+// fixed point products throw those limbs away anyway, so with skip = n - 2
+// this costs fewer than n ulps of the lowest kept limb, n - 1
+// (tests/mp_real_check.cpp holds it to that).
+inline void mulBasecase(Limb* r, const Limb* a, const Limb* b, int n, int skip = 0)
+{
+    std::memset(r, 0, 2 * n * sizeof(Limb));
+    for (int i = 0; i < n; i++)
+    {
+        Limb carry = 0;
+        for (int j = skip > i ? skip - i : 0; j < n; j++)
+        {
+            Wide t = (Wide)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (Limb)t;
+            carry = (Limb)(t >> 64);
+        }
+        r[i + n] = carry;
+    }
+}
+
+// r[0..2n) = a^2: each cross product once, doubled, plus the diagonal
+inline void sqrBasecase(Limb* r, const Limb* a, int n, int skip = 0)
+{
+    std::memset(r, 0, 2 * n * sizeof(Limb));
+    for (int i = 0; i < n; i++)
+    {
+        Limb carry = 0;
+        for (int j = skip - i > i + 1 ? skip - i : i + 1; j < n; j++)
+        {
+            Wide t = (Wide)a[i] * a[j] + r[i + j] + carry;
+            r[i + j] = (Limb)t;
+            carry = (Limb)(t >> 64);
+        }
+        r[i + n] = carry;
+    }
+
+    Limb top = 0;
+    for (int i = 0; i < 2 * n; i++)
+    {
+        Limb next = r[i] >> 63;
+        r[i] = (r[i] << 1) | top;
+        top = next;
+    }
+
+    Limb carry = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Wide square = (Wide)a[i] * a[i];
+        Wide low = (Wide)r[2 * i] + (Limb)square + carry;
+        r[2 * i] = (Limb)low;
+        Wide high = (Wide)r[2 * i + 1] + (Limb)(square >> 64) + (Limb)(low >> 64);
+        r[2 * i + 1] = (Limb)high;
+        carry = (Limb)(high >> 64);
+    }
+}
+
+// d[0..h) = |x0 - x1| where x1 has k <= h limbs; returns whether x0 < x1
+inline bool absDiff(Limb* d, const Limb* x0, const Limb* x1, int h, int k)
+{
+    bool less = false;
+    for (int i = h - 1; i >= 0; i--)
+    {
+        Limb hi = i < k ? x1[i] : 0;
+        if (x0[i] != hi)
+        {
+            less = x0[i] < hi;
+            break;
+        }
+    }
+
+    Limb borrow = 0;
+    for (int i = 0; i < h; i++)
+    {
+        Limb big = less ? (i < k ? x1[i] : 0) : x0[i];
+        Limb small = less ? x0[i] : (i < k ? x1[i] : 0);
+        Wide diff = (Wide)big - small - borrow;
+        d[i] = (Limb)diff;
+        borrow = (Limb)(diff >> 64) & 1;
+    }
+    return less;
+}
+
+// Scratch limbs needed by mulKaratsuba/sqrKaratsuba for n-limb operands
+constexpr int karatsubaScratch(int n)
+{
+    return n < KARATSUBA_THRESHOLD ? 0 : 6 * ((n + 1) / 2) + 1 + karatsubaScratch((n + 1) / 2);
+}
+
+// Shared tail of both Karatsuba variants: r holds a0b0 | a1b1, `mid` holds
+// |a0 - a1||b0 - b1|; fold in the middle term at limb h.
+inline void karatsubaCombine(Limb* r, int n, int h, const Limb* mid, bool mid_negative, Limb* t)
+{
+    int k = n - h;
+    std::memcpy(t, r, 2 * h * sizeof(Limb));
+    t[2 * h] = 0;
+    addInto(t, 2 * h + 1, r + 2 * h, 2 * k);
+    if (mid_negative)
+        addInto(t, 2 * h + 1, mid, 2 * h);
+    else
+        subFrom(t, 2 * h + 1, mid, 2 * h);
+    addInto(r + h, 2 * n - h, t, 2 * h + 1 < 2 * n - h ? 2 * h + 1 : 2 * n - h);
+}
+
+inline void mulKaratsuba(Limb* r, const Limb* a, const Limb* b, int n, Limb* scratch)
+{
+    if (n < KARATSUBA_THRESHOLD)
+    {
+        mulBasecase(r, a, b, n);
+        return;
+    }
+
+    // Low halves get the extra limb so both differences fit in h limbs
+    int h = (n + 1) / 2, k = n - h;
+    Limb* da = scratch;
+    Limb* db = da + h;
+    Limb* mid = db + h;
+    Limb* t = mid + 2 * h;
+    Limb* next = t + 2 * h + 1;
+
+    bool a_less = absDiff(da, a, a + h, h, k);
+    bool b_less = absDiff(db, b, b + h, h, k);
+
+    mulKaratsuba(r, a, b, h, next);
+    mulKaratsuba(r + 2 * h, a + h, b + h, k, next);
+    mulKaratsuba(mid, da, db, h, next);
+
+    // (a0 - a1)(b0 - b1) is negative when exactly one difference is
+    karatsubaCombine(r, n, h, mid, a_less != b_less, t);
+}
+
+inline void sqrKaratsuba(Limb* r, const Limb* a, int n, Limb* scratch)
+{
+    if (n < KARATSUBA_THRESHOLD)
+    {
+        sqrBasecase(r, a, n);
+        return;
+    }
+
+    int h = (n + 1) / 2, k = n - h;
+    Limb* da = scratch;
+    Limb* mid = da + 2 * h;
+    Limb* t = mid + 2 * h;
+    Limb* next = t + 2 * h + 1;
+
+    absDiff(da, a, a + h, h, k);
+
+    sqrKaratsuba(r, a, h, next);
+    sqrKaratsuba(r + 2 * h, a + h, k, next);
+    sqrKaratsuba(mid, da, h, next);
+
+    karatsubaCombine(r, n, h, mid, false, t);
+}
+
+} // namespace mp
+
+template <int N>
+class MpReal
+{
+public:
+    static_assert(N >= 2, "MpReal needs an integer limb and at least one fraction limb");
+
+    static constexpr int LIMBS = N;
+    static constexpr int FRACTION_BITS = 64 * (N - 1);
+
+    mp::Limb limbs[N];
+
+    MpReal() { std::memset(limbs, 0, sizeof(limbs)); }
+
+    explicit MpReal(double x)
+    {
+        int exponent;
+        double mantissa = std::frexp(x, &exponent);
+        *this = fromScaled(mantissa, exponent);
+    }
+
+    // mantissa * 2^exponent, for mantissas with at most 53 significant bits
+    static MpReal fromScaled(double mantissa, int exponent)
+    {
+        MpReal result;
+        if (mantissa == 0.0)
+            return result;
+
+        int m_exponent;
+        double m = std::frexp(std::fabs(mantissa), &m_exponent);
+        uint64_t bits = (uint64_t)std::ldexp(m, 53);
+        int shift = exponent + m_exponent - 53 + FRACTION_BITS; // bit position of `bits`
+
+        if (shift >= 64 * N)
+            return result;
+        if (shift < 0)
+        {
+            if (shift <= -64)
+                return result;
+            bits >>= -shift;
+            shift = 0;
+        }
+        int limb = shift / 64, offset = shift % 64;
+        result.limbs[limb] = bits << offset;
+        if (offset && limb + 1 < N)
+            result.limbs[limb + 1] = bits >> (64 - offset);
+
+        if (mantissa < 0)
+            mp::negate(result.limbs, N);
+        return result;
+    }
+
+    // Parses decimal notation, optionally with an exponent: "-0.75", "1.5e-40"
+    static MpReal fromString(const std::string& text)
+    {
+        MpReal result;
+        std::string digits;
+        int point = -1, exponent = 0;
+        bool negative = false;
+        size_t i = 0;
+        if (i < text.size() && (text[i] == '-' || text[i] == '+'))
+            negative = text[i++] == '-';
+        for (; i < text.size(); i++)
+        {
+            char ch = text[i];
+            if (ch >= '0' && ch <= '9')
+                digits += ch;
+            else if (ch == '.' && point < 0)
+                point = (int)digits.size();
+            else if (ch == 'e' || ch == 'E')
+            {
+                exponent = std::atoi(text.c_str() + i + 1);
+                break;
+            }
+            else
+                break;
+        }
+        if (point < 0)
+            point = (int)digits.size();
+        point += exponent;
+
+        // Integer part fits in the top limb
+        int64_t whole = 0;
+        for (int d = 0; d < point && d < (int)digits.size(); d++)
+            whole = whole * 10 + (digits[d] - '0');
+        for (int d = (int)digits.size(); d < point; d++)
+            whole *= 10;
+
+        // Fraction from the last digit up: f = (digit + f) / 10
+        mp::Limb fraction[N];
+        std::memset(fraction, 0, sizeof(fraction));
+        for (int d = (int)digits.size() - 1; d >= 0 && d >= point; d--)
+        {
+            fraction[N - 1] = (mp::Limb)(digits[d] - '0');
+            divideSmall(fraction, N, 10);
+        }
+        // Leading zeros between the point and the first digit
+        for (int d = point; d < 0; d++)
+            divideSmall(fraction, N, 10);
+
+        std::memcpy(result.limbs, fraction, sizeof(mp::Limb) * (N - 1));
+        result.limbs[N - 1] = (mp::Limb)whole;
+        if (negative)
+            mp::negate(result.limbs, N);
+        return result;
+    }
+
+    std::string toString(int digits) const
+    {
+        MpReal magnitude = abs();
+        std::string text = isNegative() ? "-" : "";
+        text += std::to_string(magnitude.limbs[N - 1]);
+        text += '.';
+
+        mp::Limb fraction[N];
+        std::memcpy(fraction, magnitude.limbs, sizeof(fraction));
+        for (int d = 0; d < digits; d++)
+        {
+            fraction[N - 1] = 0;
+            multiplySmall(fraction, N, 10);
+            text += (char)('0' + fraction[N - 1]);
+        }
+
+        while (text.back() == '0')
+            text.pop_back();
+        if (text.back() == '.')
+            text.pop_back();
+        return text;
+    }
+
+    // Decimal digits that carry information at this size
+    static int significantDigits() { return (int)(FRACTION_BITS * 0.30103) + 1; }
+
+    bool isNegative() const { return (int64_t)limbs[N - 1] < 0; }
+
+    double toDouble() const { return toFloatExp().toDouble(); }
+
+    // Keeps values far below double's range, e.g. a nucleus offset from the
+    // view center
+    floatexp toFloatExp() const
+    {
+        MpReal magnitude = abs();
+        int top = N - 1;
+        while (top > 0 && magnitude.limbs[top] == 0)
+            top--;
+        double value = (double)magnitude.limbs[top];
+        if (top > 0)
+            value += std::ldexp((double)magnitude.limbs[top - 1], -64);
+        floatexp result = floatexp(value).scaled(64 * top - FRACTION_BITS);
+        return isNegative() ? -result : result;
+    }
+
+    MpReal abs() const { return isNegative() ? -*this : *this; }
+
+    MpReal operator-() const
+    {
+        MpReal result = *this;
+        mp::negate(result.limbs, N);
+        return result;
+    }
+
+    friend MpReal operator+(const MpReal& a, const MpReal& b)
+    {
+        MpReal result;
+        mp::add(result.limbs, a.limbs, b.limbs, N);
+        return result;
+    }
+
+    friend MpReal operator-(const MpReal& a, const MpReal& b)
+    {
+        MpReal result;
+        mp::sub(result.limbs, a.limbs, b.limbs, N);
+        return result;
+    }
+
+    friend MpReal operator*(const MpReal& a, const MpReal& b)
+    {
+        if (&a == &b)
+            return a.sqr();
+
+        MpReal x = a.abs(), y = b.abs();
+        mp::Limb product[2 * N];
+        if (N < mp::KARATSUBA_THRESHOLD)
+        {
+            mp::mulBasecase(product, x.limbs, y.limbs, N, N - 2);
+            return fromProduct(product, a.isNegative() != b.isNegative());
+        }
+        mp::Limb scratch[mp::karatsubaScratch(N) + 1];
+        mp::mulKaratsuba(product, x.limbs, y.limbs, N, scratch);
+        return fromProduct(product, a.isNegative() != b.isNegative());
+    }
+
+    MpReal sqr() const
+    {
+        MpReal x = abs();
+        mp::Limb product[2 * N];
+        if (N < mp::KARATSUBA_THRESHOLD)
+        {
+            mp::sqrBasecase(product, x.limbs, N, N - 2);
+            return fromProduct(product, false);
+        }
+        mp::Limb scratch[mp::karatsubaScratch(N) + 1];
+        mp::sqrKaratsuba(product, x.limbs, N, scratch);
+        return fromProduct(product, false);
+    }
+
+    MpReal& operator+=(const MpReal& other) { return *this = *this + other; }
+    MpReal& operator-=(const MpReal& other) { return *this = *this - other; }
+
+private:
+    // Drops the extra fraction limbs of a 2N-limb product
+    static MpReal fromProduct(const mp::Limb* product, bool negative)
+    {
+        MpReal result;
+        std::memcpy(result.limbs, product + N - 1, sizeof(result.limbs));
+        if (negative)
+            mp::negate(result.limbs, N);
+        return result;
+    }
+
+    static void divideSmall(mp::Limb* x, int n, mp::Limb divisor)
+    {
+        mp::Wide remainder = 0;
+        for (int i = n - 1; i >= 0; i--)
+        {
+            mp::Wide current = (remainder << 64) | x[i];
+            x[i] = (mp::Limb)(current / divisor);
+            remainder = current % divisor;
+        }
+    }
+
+    // Fraction limbs times a small factor; the overflow lands in x[n - 1]
+    static void multiplySmall(mp::Limb* x, int n, mp::Limb factor)
+    {
+        mp::Limb carry = 0;
+        for (int i = 0; i < n - 1; i++)
+        {
+            mp::Wide t = (mp::Wide)x[i] * factor + carry;
+            x[i] = (mp::Limb)t;
+            carry = (mp::Limb)(t >> 64);
+        }
+        x[n - 1] = carry;
+    }
+};
+
+template <int N>
+inline double toDouble(const MpReal<N>& x) { return x.toDouble(); }
+
+// Calls f.run<N>() for the smallest instantiated MpReal<N> with at least
+// `bits` fraction bits, so callers only spell out the sizes once
+template <typename F>
+auto withPrecision(int bits, const F& f) -> decltype(f.template run<2>())
+{
+    if (bits <= MpReal<2>::FRACTION_BITS)
+        return f.template run<2>();
+    if (bits <= MpReal<4>::FRACTION_BITS)
+        return f.template run<4>();
+    if (bits <= MpReal<8>::FRACTION_BITS)
+        return f.template run<8>();
+    if (bits <= MpReal<16>::FRACTION_BITS)
+        return f.template run<16>();
+    if (bits <= MpReal<32>::FRACTION_BITS)
+        return f.template run<32>();
+    if (bits <= MpReal<64>::FRACTION_BITS)
+        return f.template run<64>();
+    return f.template run<128>();
+}
+
+// One orbit step (x, y) -> (x^2 - y^2 + cx, 2xy + cy). The three products are
+// independent, so past PARALLEL_PRODUCT_LIMBS two of them run on helper
+// threads that spin between steps instead of being launched per step.
+template <int N>
+class MpComplexStepper
+{
+public:
+    MpComplexStepper()
+        : parallel(N >= mp::PARALLEL_PRODUCT_LIMBS && std::thread::hardware_concurrency() >= 3),
+          generation(0), finished(0), stopping(false)
+    {
+        if (!parallel)
+            return;
+        for (int i = 0; i < 2; i++)
+            helpers[i] = std::thread(&MpComplexStepper::helperLoop, this, i);
+    }
+
+    ~MpComplexStepper()
+    {
+        if (!parallel)
+            return;
+        stopping.store(true, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        for (int i = 0; i < 2; i++)
+            helpers[i].join();
+    }
+
+    MpComplexStepper(const MpComplexStepper&) = delete;
+    MpComplexStepper& operator=(const MpComplexStepper&) = delete;
+
+    void step(MpReal<N>& x, MpReal<N>& y, const MpReal<N>& cx, const MpReal<N>& cy)
+    {
+        if (parallel)
+        {
+            x_in = &x;
+            y_in = &y;
+            unsigned target = finished.load(std::memory_order_relaxed) + 2;
+            generation.fetch_add(1, std::memory_order_release);
+            xy = x * y;
+            while (finished.load(std::memory_order_acquire) != target)
+                std::this_thread::yield();
+        }
+        else
+        {
+            xx = x.sqr();
+            yy = y.sqr();
+            xy = x * y;
+        }
+
+        x = xx - yy + cx;
+        y = xy + xy + cy;
+    }
+
+private:
+    void helperLoop(int index)
+    {
+        unsigned seen = 0;
+        for (;;)
+        {
+            unsigned current;
+            int spins = 0;
+            while ((current = generation.load(std::memory_order_acquire)) == seen)
+                if (++spins > 1000)
+                    std::this_thread::yield();
+            seen = current;
+            if (stopping.load(std::memory_order_relaxed))
+                return;
+
+            if (index == 0)
+                xx = x_in->sqr();
+            else
+                yy = y_in->sqr();
+            finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    const bool parallel;
+    std::thread helpers[2];
+    std::atomic<unsigned> generation;
+    std::atomic<unsigned> finished;
+    std::atomic<bool> stopping;
+    const MpReal<N>* x_in = nullptr;
+    const MpReal<N>* y_in = nullptr;
+    MpReal<N> xx, yy, xy;
+};
+
+#endif
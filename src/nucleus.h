@@ -0,0 +1,174 @@
+#ifndef NUCLEUS_H
+#define NUCLEUS_H
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include "floatexp.h"
+#include "mp_real.h"
+
+// Finds the nucleus (periodic center) of the lowest period minibrot inside a
+// disk of c values. A nucleus never escapes, so it makes an ideal perturbation
+// reference, and its size estimate gives a "zoom to minibrot" target.
+//
+// The period comes from ball arithmetic: the disk is iterated as a ball
+// around the center's orbit, and the first n at which that ball contains 0 is
+// the period of the dominant minibrot inside. Newton-Raphson on z_p(c) = 0 then
+// runs in MpReal with the derivative in floatexp, which only needs relative
+// precision.
+
+struct Nucleus
+{
+    bool found = false;
+    int period = 0;
+    std::string center_x;
+    std::string center_y;
+    floatexp offset_x; // nucleus - search center
+    floatexp offset_y;
+    floatexp size;     // approximate radius of the minibrot
+};
+
+constexpr int NUCLEUS_NEWTON_STEPS = 64;
+
+struct ComplexFloatExp
+{
+    floatexp re, im;
+
+    friend ComplexFloatExp operator*(const ComplexFloatExp& a, const ComplexFloatExp& b)
+    {
+        return { a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+    }
+
+    friend ComplexFloatExp operator/(const ComplexFloatExp& a, const ComplexFloatExp& b)
+    {
+        floatexp denominator = b.re * b.re + b.im * b.im;
+        return { (a.re * b.re + a.im * b.im) / denominator, (a.im * b.re - a.re * b.im) / denominator };
+    }
+
+    floatexp norm() const { return re * re + im * im; }
+};
+
+// Lowest period whose ball around (cx, cy) of the given radius contains 0, or
+// 0 if the whole ball escapes first (or `cancel` is raised)
+template <int N>
+int findPeriod(const MpReal<N>& cx, const MpReal<N>& cy, const floatexp& radius, int max_period,
+               const std::atomic<bool>* cancel = nullptr)
+{
+    MpComplexStepper<N> stepper;
+    MpReal<N> x, y;
+    floatexp r; // radius of the ball around z_n
+    floatexp z_abs;
+    for (int n = 1; n <= max_period; n++)
+    {
+        if (n % 4096 == 0 && cancel && cancel->load(std::memory_order_relaxed))
+            return 0;
+        // |z^2 + c - (Z^2 + C)| <= 2|Z|r + r^2 + radius
+        r = floatexp(2.0) * z_abs * r + r * r + radius;
+        stepper.step(x, y, cx, cy);
+
+        floatexp zx = x.toFloatExp(), zy = y.toFloatExp();
+        z_abs = sqrt(zx * zx + zy * zy);
+        if (z_abs < r)
+            return n;
+        if (z_abs > r + floatexp(2.0))
+            return 0; // every point of the ball escaped
+    }
+    return 0;
+}
+
+template <int N>
+Nucleus findNucleusMp(const std::string& center_x, const std::string& center_y, const floatexp& radius, int max_period,
+                      const std::atomic<bool>* cancel = nullptr)
+{
+    Nucleus nucleus;
+    const MpReal<N> start_x = MpReal<N>::fromString(center_x);
+    const MpReal<N> start_y = MpReal<N>::fromString(center_y);
+    int period = findPeriod(start_x, start_y, radius, max_period, cancel);
+    if (period == 0)
+        return nucleus;
+
+    // Stop once steps are within a few ulps of the working precision
+    const floatexp epsilon = floatexp(1.0).scaled(-MpReal<N>::FRACTION_BITS + 8);
+    MpReal<N> cx = start_x, cy = start_y;
+    bool converged = false;
+    for (int step = 0; step < NUCLEUS_NEWTON_STEPS && !converged; step++)
+    {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return nucleus;
+        MpComplexStepper<N> stepper;
+        MpReal<N> x, y;
+        ComplexFloatExp dz = { floatexp(), floatexp() };
+        for (int n = 0; n < period; n++)
+        {
+            // dz/dc -> 2 z dz/dc + 1, using z before the step
+            ComplexFloatExp z2 = { floatexp(2.0 * x.toDouble()), floatexp(2.0 * y.toDouble()) };
+            dz = z2 * dz;
+            dz.re += floatexp(1.0);
+            stepper.step(x, y, cx, cy);
+        }
+
+        ComplexFloatExp z = { x.toFloatExp(), y.toFloatExp() };
+        ComplexFloatExp delta = z / dz;
+        cx = cx - MpReal<N>::fromScaled(delta.re.mantissa, delta.re.exponent);
+        cy = cy - MpReal<N>::fromScaled(delta.im.mantissa, delta.im.exponent);
+        converged = delta.norm() < epsilon * epsilon;
+    }
+
+    // Newton can wander off to a neighbouring component; only accept results
+    // that stayed near the search disk
+    floatexp offset_x = (cx - start_x).toFloatExp(), offset_y = (cy - start_y).toFloatExp();
+    if (!converged || offset_x * offset_x + offset_y * offset_y > floatexp(4.0) * radius * radius)
+        return nucleus;
+
+    // Size estimate: with l_n = dz_n/dz_1 along the orbit and b = sum 1/l_n,
+    // the minibrot's radius is about 1 / |b l_p^2|
+    MpComplexStepper<N> stepper;
+    MpReal<N> x, y;
+    ComplexFloatExp l = { floatexp(1.0), floatexp() };
+    ComplexFloatExp b = { floatexp(1.0), floatexp() };
+    ComplexFloatExp one = { floatexp(1.0), floatexp() };
+    for (int n = 1; n < period; n++)
+    {
+        stepper.step(x, y, cx, cy);
+        ComplexFloatExp z2 = { floatexp(2.0 * x.toDouble()), floatexp(2.0 * y.toDouble()) };
+        l = z2 * l;
+        ComplexFloatExp inverse = one / l;
+        b.re += inverse.re;
+        b.im += inverse.im;
+    }
+    ComplexFloatExp size = one / (b * l * l);
+
+    int digits = std::min(MpReal<N>::significantDigits(), std::max(20, (int)(-radius.log2() * 0.30103) + 20));
+    nucleus.found = true;
+    nucleus.period = period;
+    nucleus.center_x = cx.toString(digits);
+    nucleus.center_y = cy.toString(digits);
+    nucleus.offset_x = offset_x;
+    nucleus.offset_y = offset_y;
+    nucleus.size = sqrt(size.norm());
+    return nucleus;
+}
+
+struct NucleusSearch
+{
+    const std::string& center_x;
+    const std::string& center_y;
+    const floatexp& radius;
+    int max_period;
+    const std::atomic<bool>* cancel;
+
+    template <int N>
+    Nucleus run() const { return findNucleusMp<N>(center_x, center_y, radius, max_period, cancel); }
+};
+
+// Searches the disk of `radius` around a decimal center, at a precision that
+// resolves a small fraction of the radius
+inline Nucleus findNucleus(const std::string& center_x, const std::string& center_y, const floatexp& radius, int max_period,
+                           const std::atomic<bool>* cancel = nullptr)
+{
+    NucleusSearch search = { center_x, center_y, radius, max_period, cancel };
+    return withPrecision(std::max(64, -radius.exponent + 96), search);
+}
+
+#endif
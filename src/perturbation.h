@@ -0,0 +1,587 @@
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "floatexp.h"
+#include "mp_real.h"
+#include "nucleus.h"
+#include "tile_scheduler.h"
+
+// Perturbation rendering: one reference orbit Z_n is iterated in high
+// precision at c_ref, and every pixel only tracks its small delta
+// dz_n = z_n - Z_n, with dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc.
+//
+// Deltas are rebased onto the start of the reference whenever |z| < |dz| or
+// the reference runs out (Zhuoran's method). Whatever still fails
+// Pauldelbrot's criterion |z|^2 < tolerance * |Z|^2 is flagged as glitched
+// and re-rendered against a secondary reference placed inside the glitch.
+//
+// Pixels are spread over a tile pool when there is one. After each pass the
+// glitched pixels are split into connected regions and every region gets a
+// secondary reference of its own, so separate glitches are fixed in the same
+// pass.
+//
+// Iteration counts follow the fragment shader: the index of the iteration
+// that escaped, or max_iterations. Buffers are row-major, bottom row first,
+// so they line up with gl_FragCoord and glReadPixels.
+
+// Z_n rounded to double; |Z_n| <= 2 until the last entry, so the range of
+// double is always enough here.
+struct ReferenceOrbit
+{
+    std::vector<double> re;
+    std::vector<double> im;
+    std::vector<double> glitch_bound; // tolerance * |Z_n|^2
+
+    int length() const { return (int)re.size(); }
+};
+
+// A primary reference and where it sits relative to the view center
+struct PrimaryReference
+{
+    std::shared_ptr<const ReferenceOrbit> orbit;
+    floatexp offset_x, offset_y;
+    int period = 0; // of the nucleus it was placed on, if any
+};
+
+struct PerturbationOptions
+{
+    bool rebase = true;
+    bool detect_glitches = true;
+    int max_references = 16;
+    double glitch_tolerance = 1e-6;
+    bool find_reference = true; // start from the nucleus of the view's lowest period minibrot
+    const std::atomic<bool>* cancel = nullptr; // polled every few pixels; deep pixels can be slow
+    TileScheduler* scheduler = nullptr; // runs pixels and secondary references; null for the calling thread
+    // Rows [first_row, first_row + rows) of the view, into a buffer holding
+    // just those rows; negative rows means the whole view
+    int first_row = 0;
+    int rows = -1;
+    // Reused instead of searching for a nucleus and iterating a new orbit,
+    // when it was made for the same center, iterations and tolerance
+    PrimaryReference reference;
+};
+
+struct PerturbationStats
+{
+    int references = 0;
+    int glitched_pixels = 0; // still glitched after the last reference
+    int reference_period = 0; // period of the primary reference if it's a nucleus
+    bool used_floatexp = false;
+    PrimaryReference primary; // for the next render of the same view
+};
+
+inline double toDouble(long double x) { return (double)x; }
+
+// Move a high precision coordinate by a (possibly tiny) floatexp offset
+inline long double offsetReal(long double x, const floatexp& offset)
+{
+    if (offset.isZero())
+        return x;
+    return x + std::ldexp((long double)offset.mantissa, offset.exponent);
+}
+
+template <int N>
+inline MpReal<N> offsetReal(const MpReal<N>& x, const floatexp& offset)
+{
+    if (offset.isZero())
+        return x;
+    return x + MpReal<N>::fromScaled(offset.mantissa, offset.exponent);
+}
+
+// z -> z^2 + c on the reference's real type
+template <typename Real>
+struct ReferenceStepper
+{
+    void step(Real& x, Real& y, const Real& cx, const Real& cy)
+    {
+        Real xx = x * x;
+        Real yy = y * y;
+        Real xy = x * y;
+        x = xx - yy + cx;
+        y = xy + xy + cy;
+    }
+};
+
+template <int N>
+struct ReferenceStepper<MpReal<N>> : MpComplexStepper<N>
+{
+};
+
+template <typename Real>
+ReferenceOrbit computeReferenceOrbit(const Real& cx, const Real& cy, int max_iterations, double glitch_tolerance,
+                                     const std::atomic<bool>* cancel = nullptr)
+{
+    ReferenceOrbit orbit;
+    orbit.re.reserve(max_iterations + 1);
+    orbit.im.reserve(max_iterations + 1);
+    orbit.glitch_bound.reserve(max_iterations + 1);
+
+    ReferenceStepper<Real> stepper;
+    Real x = cx - cx, y = x; // zero without assuming a constructor from int
+    orbit.re.push_back(0.0);
+    orbit.im.push_back(0.0);
+    orbit.glitch_bound.push_back(0.0);
+    for (int i = 0; i < max_iterations; i++)
+    {
+        // A cancelled orbit comes back short; the caller checks the flag too
+        if (i % 4096 == 0 && cancel && cancel->load(std::memory_order_relaxed))
+            break;
+        stepper.step(x, y, cx, cy);
+
+        double zx = toDouble(x), zy = toDouble(y);
+        double norm = zx * zx + zy * zy;
+        orbit.re.push_back(zx);
+        orbit.im.push_back(zy);
+        orbit.glitch_bound.push_back(glitch_tolerance * norm);
+        if (norm > 4.0)
+            break;
+    }
+
+    return orbit;
+}
+
+// Iterates one pixel against `orbit`. `glitch` receives |z|^2 / |Z|^2 at the
+// point the pixel was flagged, or stays negative if it wasn't.
+template <typename D>
+int iteratePerturbed(const ReferenceOrbit& orbit, const D& dcx, const D& dcy, int max_iterations,
+                     const PerturbationOptions& options, double& glitch)
+{
+    const int last = orbit.length() - 1;
+    D dzx = D(0.0), dzy = D(0.0);
+    int n = 0;
+    glitch = -1.0;
+
+    for (int i = 0; i < max_iterations; i++)
+    {
+        double Zx2 = 2.0 * orbit.re[n], Zy2 = 2.0 * orbit.im[n];
+        D ax = dzx + D(Zx2), ay = dzy + D(Zy2);
+        D next_x = dzx * ax - dzy * ay + dcx;
+        D next_y = dzx * ay + dzy * ax + dcy;
+        dzx = next_x;
+        dzy = next_y;
+        n++;
+
+        double zx = orbit.re[n] + toDouble(dzx);
+        double zy = orbit.im[n] + toDouble(dzy);
+        double norm = zx * zx + zy * zy;
+        if (norm > 4.0)
+            return i;
+
+        if (options.rebase)
+        {
+            double dz_norm = toDouble(dzx * dzx + dzy * dzy);
+            if (norm < dz_norm || n == last)
+            {
+                dzx = D(zx);
+                dzy = D(zy);
+                n = 0;
+            }
+        }
+        else if (n == last)
+        {
+            // Reference escaped before this pixel did; nothing left to follow
+            glitch = 0.0;
+            return i;
+        }
+
+        if (options.detect_glitches && n != 0 && norm < orbit.glitch_bound[n])
+        {
+            glitch = norm / (orbit.re[n] * orbit.re[n] + orbit.im[n] * orbit.im[n]);
+            return i;
+        }
+    }
+
+    return max_iterations;
+}
+
+// Pixel offset from the view center, matching the shader's
+// (gl_FragCoord.xy / u_resolution - 0.5) * u_zoom
+inline floatexp pixelOffset(int pixel, int size, const floatexp& zoom)
+{
+    return floatexp((pixel + 0.5) / size - 0.5) * zoom;
+}
+
+// Points with no known layout: every glitched pixel is one region
+struct NoNeighbours
+{
+    template <typename Visit>
+    void operator()(size_t, const Visit&) const
+    {
+    }
+};
+
+// Splits glitched pixels into connected regions; neighbours(i, visit) calls
+// visit(j) for each point j next to point i
+template <typename Neighbours>
+std::vector<std::vector<size_t>> glitchRegions(const std::vector<size_t>& glitched, size_t count,
+                                               const Neighbours& neighbours)
+{
+    std::vector<uint8_t> open(count, 0);
+    for (size_t index : glitched)
+        open[index] = 1;
+
+    std::vector<std::vector<size_t>> regions;
+    std::vector<size_t> stack;
+    for (size_t seed : glitched)
+    {
+        if (!open[seed])
+            continue;
+        open[seed] = 0;
+        regions.emplace_back();
+        std::vector<size_t>& region = regions.back();
+        stack.push_back(seed);
+        while (!stack.empty())
+        {
+            size_t index = stack.back();
+            stack.pop_back();
+            region.push_back(index);
+            neighbours(index, [&](size_t next)
+            {
+                if (open[next])
+                {
+                    open[next] = 0;
+                    stack.push_back(next);
+                }
+            });
+        }
+        std::sort(region.begin(), region.end());
+    }
+    return regions;
+}
+
+inline std::vector<std::vector<size_t>> glitchRegions(const std::vector<size_t>& glitched, size_t,
+                                                      const NoNeighbours&)
+{
+    return { glitched };
+}
+
+// Runs body(list, first, last, worker) over chunks of [0, counts[list]) for
+// every list, on the scheduler when there is one
+template <typename Body>
+void forEachChunk(TileScheduler* scheduler, const std::vector<size_t>& counts, size_t chunk, const Body& body)
+{
+    if (!scheduler)
+    {
+        for (size_t list = 0; list < counts.size(); list++)
+            body(list, 0, counts[list], 0);
+        return;
+    }
+    std::vector<Tile> tiles;
+    for (size_t list = 0; list < counts.size(); list++)
+        for (size_t first = 0; first < counts[list]; first += chunk)
+            tiles.push_back({ (int)first, (int)list, (int)std::min(chunk, counts[list] - first), 1 });
+    scheduler->run(tiles, [&](const Tile& tile, int worker)
+    {
+        body((size_t)tile.y, (size_t)tile.x, (size_t)tile.x + tile.width, worker);
+    });
+}
+
+// Renders `count` points, point i at offsets(i, offset_x, offset_y) from the
+// center, against a primary reference at (`ref_x`, `ref_y`) and secondary
+// ones placed inside whatever glitches. `neighbours` gives the layout the
+// glitch regions are found in.
+template <typename D, typename Real, typename Offsets, typename Neighbours = NoNeighbours>
+PerturbationStats renderPerturbationPoints(const Real& center_x, const Real& center_y, size_t count,
+                                           const Offsets& offsets, int max_iterations,
+                                           const PerturbationOptions& options, std::vector<int>& iterations,
+                                           floatexp ref_x = floatexp(), floatexp ref_y = floatexp(),
+                                           const Neighbours& neighbours = Neighbours())
+{
+    // Pixels handed to a worker at a time, and the smallest glitch that gets
+    // a reference of its own
+    const size_t PIXEL_CHUNK = 256;
+    const size_t MIN_REGION_PIXELS = 16;
+
+    struct Group
+    {
+        std::shared_ptr<const ReferenceOrbit> orbit;
+        floatexp ref_x, ref_y;
+        std::vector<size_t> pixels;
+    };
+
+    PerturbationStats stats;
+    stats.used_floatexp = !std::is_same<D, double>::value;
+    auto cancelled = [&]() { return options.cancel && options.cancel->load(std::memory_order_relaxed); };
+
+    iterations.assign(count, max_iterations);
+    std::vector<double> glitch(count, -1.0);
+    std::vector<Group> groups(1);
+    groups[0].ref_x = ref_x;
+    groups[0].ref_y = ref_y;
+    groups[0].pixels.resize(count);
+    for (size_t i = 0; i < count; i++)
+        groups[0].pixels[i] = i;
+    if (options.reference.orbit)
+    {
+        groups[0].orbit = options.reference.orbit;
+        groups[0].ref_x = options.reference.offset_x;
+        groups[0].ref_y = options.reference.offset_y;
+        stats.primary.period = options.reference.period;
+    }
+
+    int workers = options.scheduler ? options.scheduler->workerCount() : 1;
+    std::vector<std::vector<size_t>> worker_glitched(workers);
+    std::vector<size_t> waiting; // glitched, in regions that didn't get a reference yet
+    while (!groups.empty())
+    {
+        // Reference orbits are serial, but the regions' run side by side
+        std::vector<size_t> orbit_counts(groups.size(), 1);
+        forEachChunk(options.scheduler, orbit_counts, 1, [&](size_t group, size_t, size_t, int)
+        {
+            Group& target = groups[group];
+            if (!target.orbit)
+                target.orbit = std::make_shared<const ReferenceOrbit>(computeReferenceOrbit(
+                    offsetReal(center_x, target.ref_x), offsetReal(center_y, target.ref_y), max_iterations,
+                    options.glitch_tolerance, options.cancel));
+        });
+        if (stats.references == 0)
+        {
+            stats.primary.orbit = groups[0].orbit;
+            stats.primary.offset_x = groups[0].ref_x;
+            stats.primary.offset_y = groups[0].ref_y;
+        }
+        stats.references += (int)groups.size();
+        if (cancelled())
+            return stats;
+
+        std::vector<size_t> pixel_counts(groups.size());
+        for (size_t group = 0; group < groups.size(); group++)
+            pixel_counts[group] = groups[group].pixels.size();
+        forEachChunk(options.scheduler, pixel_counts, PIXEL_CHUNK, [&](size_t group, size_t first, size_t last, int worker)
+        {
+            const Group& source = groups[group];
+            for (size_t i = first; i < last; i++)
+            {
+                if ((i - first) % 16 == 0 && cancelled())
+                    return;
+                size_t index = source.pixels[i];
+                floatexp offset_x, offset_y;
+                offsets(index, offset_x, offset_y);
+                D dcx = fromFloatExp<D>(offset_x - source.ref_x);
+                D dcy = fromFloatExp<D>(offset_y - source.ref_y);
+                iterations[index] = iteratePerturbed(*source.orbit, dcx, dcy, max_iterations, options, glitch[index]);
+                if (glitch[index] >= 0.0)
+                    worker_glitched[worker].push_back(index);
+            }
+        });
+        if (cancelled())
+            return stats;
+
+        std::vector<size_t> glitched;
+        glitched.swap(waiting);
+        for (std::vector<size_t>& list : worker_glitched)
+        {
+            glitched.insert(glitched.end(), list.begin(), list.end());
+            list.clear();
+        }
+        std::sort(glitched.begin(), glitched.end());
+        groups.clear();
+        if (glitched.empty())
+            break;
+
+        int budget = options.max_references - stats.references;
+        if (budget <= 0)
+        {
+            stats.glitched_pixels = (int)glitched.size();
+            break;
+        }
+
+        // The biggest glitches get references first, and each pass keeps half
+        // the budget back for what the new references still miss; regions
+        // left out wait for the next pass. Specks aren't worth a reference of
+        // their own and go along with the biggest region. The most glitched
+        // pixel of a region is closest to the feature the old reference
+        // couldn't follow, so it makes the best new reference; ties go to
+        // the middle of the region.
+        std::vector<std::vector<size_t>> regions = glitchRegions(glitched, count, neighbours);
+        std::stable_sort(regions.begin(), regions.end(),
+                         [](const std::vector<size_t>& a, const std::vector<size_t>& b) { return a.size() > b.size(); });
+        size_t pass_references = (size_t)std::max(1, budget / 2);
+        std::vector<size_t> specks;
+        for (size_t r = 0; r < regions.size(); r++)
+        {
+            if (r > 0 && regions[r].size() < MIN_REGION_PIXELS)
+            {
+                specks.insert(specks.end(), regions[r].begin(), regions[r].end());
+                continue;
+            }
+            if (groups.size() >= pass_references)
+            {
+                waiting.insert(waiting.end(), regions[r].begin(), regions[r].end());
+                continue;
+            }
+            size_t worst = regions[r][regions[r].size() / 2];
+            for (size_t index : regions[r])
+                if (glitch[index] < glitch[worst])
+                    worst = index;
+            Group group;
+            offsets(worst, group.ref_x, group.ref_y);
+            group.pixels.swap(regions[r]);
+            groups.push_back(std::move(group));
+        }
+        if (!specks.empty())
+        {
+            std::vector<size_t>& pixels = groups[0].pixels;
+            pixels.insert(pixels.end(), specks.begin(), specks.end());
+            std::sort(pixels.begin(), pixels.end());
+        }
+    }
+
+    return stats;
+}
+
+// The view's rows from options.first_row as a grid of points; `ref_x`/`ref_y`
+// place the primary reference relative to the center
+template <typename D, typename Real>
+PerturbationStats renderPerturbationAs(const Real& center_x, const Real& center_y, const floatexp& zoom,
+                                       int width, int height, int max_iterations,
+                                       const PerturbationOptions& options, std::vector<int>& iterations,
+                                       floatexp ref_x = floatexp(), floatexp ref_y = floatexp())
+{
+    int rows = options.rows < 0 ? height : options.rows;
+    std::vector<floatexp> offset_x(width), offset_y(rows);
+    for (int x = 0; x < width; x++)
+        offset_x[x] = pixelOffset(x, width, zoom);
+    for (int y = 0; y < rows; y++)
+        offset_y[y] = pixelOffset(options.first_row + y, height, zoom);
+
+    auto offsets = [&](size_t index, floatexp& x, floatexp& y)
+    {
+        x = offset_x[index % width];
+        y = offset_y[index / width];
+    };
+    size_t count = (size_t)width * rows;
+    auto neighbours = [&](size_t index, const auto& visit)
+    {
+        size_t x = index % width;
+        if (x > 0)
+            visit(index - 1);
+        if (x + 1 < (size_t)width)
+            visit(index + 1);
+        if (index >= (size_t)width)
+            visit(index - width);
+        if (index + width < count)
+            visit(index + width);
+    };
+    return renderPerturbationPoints<D>(center_x, center_y, count, offsets, max_iterations, options, iterations, ref_x,
+                                       ref_y, neighbours);
+}
+
+// Renders a width x height view of the given zoom (the shader's u_zoom) around
+// a high precision center, picking floatexp deltas once double runs out of
+// range.
+template <typename Real>
+PerturbationStats renderPerturbation(const Real& center_x, const Real& center_y, const floatexp& zoom,
+                                     int width, int height, int max_iterations,
+                                     const PerturbationOptions& options, std::vector<int>& iterations,
+                                     const floatexp& ref_x = floatexp(), const floatexp& ref_y = floatexp())
+{
+    floatexp pixel_spacing = zoom / floatexp((double)std::max(width, height));
+    if (needsFloatExp(pixel_spacing))
+        return renderPerturbationAs<floatexp>(center_x, center_y, zoom, width, height, max_iterations, options, iterations, ref_x, ref_y);
+    return renderPerturbationAs<double>(center_x, center_y, zoom, width, height, max_iterations, options, iterations, ref_x, ref_y);
+}
+
+// Fraction bits the reference needs to resolve pixels `pixel_spacing` apart,
+// with guard bits for the error the orbit accumulates
+inline int referencePrecisionBits(const floatexp& pixel_spacing)
+{
+    return std::max(64, -pixel_spacing.exponent + 64);
+}
+
+// Places and iterates the primary reference for a view: on the nucleus of
+// the lowest period minibrot in the view when there is one, since that runs
+// the full iteration count and almost no pixel then needs a secondary
+// reference, otherwise on the center
+template <int N>
+PrimaryReference findPrimaryReferenceAs(const std::string& center_x, const std::string& center_y, const floatexp& zoom,
+                                        int max_iterations, const PerturbationOptions& options)
+{
+    Nucleus nucleus;
+    if (options.find_reference)
+        nucleus = findNucleusMp<N>(center_x, center_y, zoom * floatexp(0.7071), max_iterations, options.cancel);
+    floatexp half_zoom = zoom.scaled(-1);
+    bool in_view = nucleus.found && abs(nucleus.offset_x) <= half_zoom && abs(nucleus.offset_y) <= half_zoom;
+
+    PrimaryReference reference;
+    if (in_view)
+    {
+        reference.offset_x = nucleus.offset_x;
+        reference.offset_y = nucleus.offset_y;
+        reference.period = nucleus.period;
+    }
+    reference.orbit = std::make_shared<const ReferenceOrbit>(computeReferenceOrbit(
+        offsetReal(MpReal<N>::fromString(center_x), reference.offset_x),
+        offsetReal(MpReal<N>::fromString(center_y), reference.offset_y), max_iterations, options.glitch_tolerance,
+        options.cancel));
+    return reference;
+}
+
+struct PerturbationRender
+{
+    const std::string& center_x;
+    const std::string& center_y;
+    const floatexp& zoom;
+    int width;
+    int height;
+    int max_iterations;
+    const PerturbationOptions& options;
+    std::vector<int>& iterations;
+
+    template <int N>
+    PerturbationStats run() const
+    {
+        PerturbationOptions render_options = options;
+        if (!render_options.reference.orbit)
+            render_options.reference = findPrimaryReferenceAs<N>(center_x, center_y, zoom, max_iterations, options);
+        PerturbationStats stats = renderPerturbation(MpReal<N>::fromString(center_x), MpReal<N>::fromString(center_y), zoom,
+                                                     width, height, max_iterations, render_options, iterations);
+        stats.reference_period = render_options.reference.period;
+        return stats;
+    }
+};
+
+struct PrimaryReferenceSearch
+{
+    const std::string& center_x;
+    const std::string& center_y;
+    const floatexp& zoom;
+    int max_iterations;
+    const PerturbationOptions& options;
+
+    template <int N>
+    PrimaryReference run() const
+    {
+        return findPrimaryReferenceAs<N>(center_x, center_y, zoom, max_iterations, options);
+    }
+};
+
+// The primary reference a width x height view would use, to share between
+// renders around the same center: bands of one view, or the frames of a zoom
+inline PrimaryReference findPrimaryReference(const std::string& center_x, const std::string& center_y,
+                                             const floatexp& zoom, int width, int height, int max_iterations,
+                                             const PerturbationOptions& options)
+{
+    PrimaryReferenceSearch search = { center_x, center_y, zoom, max_iterations, options };
+    return withPrecision(referencePrecisionBits(zoom / floatexp((double)std::max(width, height))), search);
+}
+
+// Same as above for a decimal center, picking the smallest MpReal that
+// carries enough bits for the zoom
+inline PerturbationStats renderPerturbation(const std::string& center_x, const std::string& center_y, const floatexp& zoom,
+                                            int width, int height, int max_iterations,
+                                            const PerturbationOptions& options, std::vector<int>& iterations)
+{
+    PerturbationRender render = { center_x, center_y, zoom, width, height, max_iterations, options, iterations };
+    return withPrecision(referencePrecisionBits(zoom / floatexp((double)std::max(width, height))), render);
+}
+
+#endif
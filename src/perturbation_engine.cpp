@@ -0,0 +1,83 @@
+#include "perturbation_engine.h"
+
+#include <algorithm>
+
+PrimaryReference ReferenceCache::find(const View& view)
+{
+    int bits = referencePrecisionBits(view.pixelSpacing());
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Entry& entry : entries)
+    {
+        const View& cached = entry.view;
+        if (cached.fractal == view.fractal && cached.center_x == view.center_x && cached.center_y == view.center_y
+            && cached.zoom.mantissa == view.zoom.mantissa && cached.zoom.exponent == view.zoom.exponent
+            && cached.max_iterations == view.max_iterations && entry.precision_bits >= bits)
+        {
+            entry.last_used = ++clock;
+            hit_count++;
+            return entry.reference;
+        }
+    }
+    miss_count++;
+    return PrimaryReference();
+}
+
+void ReferenceCache::store(const View& view, const PrimaryReference& reference)
+{
+    if (!reference.orbit || capacity == 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.size() >= capacity)
+    {
+        auto oldest = std::min_element(entries.begin(), entries.end(),
+                                       [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+        entries.erase(oldest);
+    }
+    entries.push_back({ view, referencePrecisionBits(view.pixelSpacing()), reference, ++clock });
+}
+
+int ReferenceCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return hit_count;
+}
+
+int ReferenceCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return miss_count;
+}
+
+PerturbationEngine::PerturbationEngine(std::shared_ptr<TileScheduler> scheduler)
+    : scheduler(scheduler ? scheduler : std::make_shared<TileScheduler>())
+{
+}
+
+bool PerturbationEngine::render(const View& view, IterationBuffer& buffer)
+{
+    return renderBand(view, buffer, 0, view.height);
+}
+
+bool PerturbationEngine::renderBand(const View& view, IterationBuffer& band, int first_row, int rows)
+{
+    if (view.fractal != Fractal::MANDELBROT)
+        return false;
+
+    band.resize(view.width, rows);
+    PerturbationOptions band_options = options;
+    bool lookup = references && !band_options.reference.orbit;
+    if (lookup)
+        band_options.reference = references->find(view);
+    last_reference_cached = band_options.reference.orbit && lookup;
+    band_options.cancel = cancel_flag;
+    band_options.scheduler = scheduler.get();
+    band_options.first_row = first_row;
+    band_options.rows = rows;
+    last_stats = renderPerturbation(view.center_x, view.center_y, view.zoom, view.width, view.height,
+                                    view.max_iterations, band_options, band.iterations);
+    if (cancelled())
+        return false;
+    if (lookup && !last_reference_cached)
+        references->store(view, last_stats.primary);
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef PERTURBATION_ENGINE_H
+#define PERTURBATION_ENGINE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "engine.h"
+#include "perturbation.h"
+
+// Primary references kept between renders of the same place, such as a
+// thumbnail and a poster of one location. A reference serves a view of the
+// same fractal, center, zoom and iteration limit whose pixels are no finer
+// than the ones it was computed for. Safe to share between threads.
+class ReferenceCache
+{
+public:
+    explicit ReferenceCache(size_t capacity = 8) : capacity(capacity) {}
+
+    // No orbit if nothing cached fits `view`
+    PrimaryReference find(const View& view);
+    // Evicts the least recently used reference once full
+    void store(const View& view, const PrimaryReference& reference);
+
+    int hits() const;
+    int misses() const;
+
+private:
+    struct Entry
+    {
+        View view;
+        int precision_bits;
+        PrimaryReference reference;
+        uint64_t last_used;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+    size_t capacity;
+    uint64_t clock = 0;
+    int hit_count = 0;
+    int miss_count = 0;
+};
+
+// CPU engine for zooms past what the GPU's floats can address
+class PerturbationEngine : public Engine
+{
+public:
+    // Pixels run on `scheduler`, or on a pool of the engine's own if null
+    explicit PerturbationEngine(std::shared_ptr<TileScheduler> scheduler = nullptr);
+
+    PerturbationOptions options;
+    // Where primary references come from and go to when options.reference
+    // is empty; null to search for each render
+    std::shared_ptr<ReferenceCache> references;
+
+    EngineType type() const override { return EngineType::PERTURBATION; }
+    bool render(const View& view, IterationBuffer& buffer) override;
+
+    // Renders `rows` rows of the view starting at `first_row` into a buffer
+    // holding just those rows, like CpuEngine::renderBand(). Set
+    // options.reference to lastStats().primary to spare later bands the
+    // reference search.
+    bool renderBand(const View& view, IterationBuffer& band, int first_row, int rows);
+
+    const PerturbationStats& lastStats() const { return last_stats; }
+    // Whether the last render's primary reference came from `references`
+    bool lastReferenceCached() const { return last_reference_cached; }
+
+private:
+    std::shared_ptr<TileScheduler> scheduler;
+    PerturbationStats last_stats;
+    bool last_reference_cached = false;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "precision_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "cpu_engine.h"
+#include "fixed128.h"
+#include "formula_kernels.h"
+#include "simd_kernels.h"
+
+namespace
+{
+
+// Rough seconds per pixel-iteration on one core before anything is measured;
+// only the ordering really matters
+double coreCost(PrecisionTier tier)
+{
+    switch (tier)
+    {
+        case PrecisionTier::GPU_FLOAT:
+            return 1e-10;
+        case PrecisionTier::CPU_FLOAT:
+            return 1.5e-9;
+        case PrecisionTier::CPU_DOUBLE:
+            return 3e-9;
+        case PrecisionTier::PERTURBATION:
+            return 1.5e-8;
+        case PrecisionTier::CPU_FIXED128:
+            return 6e-8;
+        default:
+            return 1e-7;
+    }
+}
+
+// Every tier but the GPU's runs on the whole tile pool
+double priorCost(PrecisionTier tier)
+{
+    if (tier == PrecisionTier::GPU_FLOAT)
+        return coreCost(tier);
+    static const double workers = std::max(1u, std::thread::hardware_concurrency());
+    return coreCost(tier) / workers;
+}
+
+// Priors are only guesses, so a tier that hasn't been measured yet gets one
+// frame if its prior is within this factor of the best measured tier
+constexpr double EXPLORE_RATIO = 8.0;
+
+// Weight of the newest frame in the running average
+constexpr double COST_SMOOTHING = 0.3;
+
+const PrecisionTier ALL_TIERS[] = {
+    PrecisionTier::GPU_FLOAT,
+    PrecisionTier::CPU_FLOAT,
+    PrecisionTier::CPU_DOUBLE,
+    PrecisionTier::CPU_FIXED128,
+    PrecisionTier::CPU_DOUBLE_DOUBLE,
+    PrecisionTier::PERTURBATION
+};
+
+}
+
+double PrecisionPlanner::headroomBits(PrecisionTier tier, const View& view)
+{
+    // Same limits as floatResolvesView() and friends in the CPU engine
+    double spacing = view.pixelSpacing().log2();
+    double magnitude = std::log2(std::max(1.0, std::max(std::fabs(view.centerX()), std::fabs(view.centerY()))));
+    switch (tier)
+    {
+        case PrecisionTier::GPU_FLOAT:
+        case PrecisionTier::CPU_FLOAT:
+            return spacing - (magnitude - 16.0);
+        case PrecisionTier::CPU_DOUBLE:
+            return spacing - (magnitude - 45.0);
+        case PrecisionTier::CPU_FIXED128:
+            if (!fixed128Holds(view.centerX(), view.centerY(), view.zoom.toDouble()))
+                return -std::numeric_limits<double>::infinity();
+            return spacing + (Fixed128::FRACTION_BITS - 8);
+        case PrecisionTier::CPU_DOUBLE_DOUBLE:
+            return spacing - (magnitude - 98.0);
+        default:
+            return std::numeric_limits<double>::infinity();
+    }
+}
+
+bool PrecisionPlanner::supports(PrecisionTier tier, const View& view) const
+{
+    switch (tier)
+    {
+        case PrecisionTier::GPU_FLOAT:
+            return gpu_available;
+        case PrecisionTier::CPU_FLOAT:
+            return view.max_iterations <= FLOAT_KERNEL_MAX_ITERATIONS;
+        case PrecisionTier::CPU_FIXED128:
+            return formulaSpanKernel<Fixed128>(view.fractal, InteriorChecks()) != nullptr;
+        case PrecisionTier::PERTURBATION:
+            return view.fractal == Fractal::MANDELBROT;
+        default:
+            return formulaSpanKernel<double>(view.fractal, InteriorChecks()) != nullptr;
+    }
+}
+
+double PrecisionPlanner::expectedSeconds(PrecisionTier tier, const View& view) const
+{
+    auto found = measured_cost.find(tier);
+    double cost = found != measured_cost.end() ? found->second : priorCost(tier);
+    return cost * (double)view.width * view.height * view.max_iterations;
+}
+
+double PrecisionPlanner::expectedThroughput(PrecisionTier tier, const View& view) const
+{
+    double seconds = expectedSeconds(tier, view);
+    return seconds > 0.0 ? (double)view.width * view.height / seconds : 0.0;
+}
+
+PrecisionTier cpuPrecisionTier(CpuPrecision precision)
+{
+    switch (precision)
+    {
+        case CpuPrecision::FLOAT:
+            return PrecisionTier::CPU_FLOAT;
+        case CpuPrecision::FIXED128:
+            return PrecisionTier::CPU_FIXED128;
+        case CpuPrecision::DOUBLE_DOUBLE:
+            return PrecisionTier::CPU_DOUBLE_DOUBLE;
+        default:
+            return PrecisionTier::CPU_DOUBLE;
+    }
+}
+
+PrecisionTier PrecisionPlanner::plan(const View& view)
+{
+    bool current_ok = planned && supports(current_tier, view) && headroomBits(current_tier, view) > 0.0;
+
+    PrecisionTier best = PrecisionTier::PERTURBATION;
+    double best_seconds = std::numeric_limits<double>::infinity();
+    bool found = false;
+    for (PrecisionTier tier : ALL_TIERS)
+    {
+        if (!supports(tier, view))
+            continue;
+        // Tiers cheaper than the current one need some margin to come back
+        double needed = current_ok && tier < current_tier ? hysteresis_bits : 0.0;
+        if (headroomBits(tier, view) <= needed)
+            continue;
+        double seconds = expectedSeconds(tier, view);
+        if (!found || seconds < best_seconds)
+        {
+            best = tier;
+            best_seconds = seconds;
+            found = true;
+        }
+    }
+    if (!found)
+        best = supports(PrecisionTier::CPU_DOUBLE_DOUBLE, view) ? PrecisionTier::CPU_DOUBLE_DOUBLE : PrecisionTier::CPU_DOUBLE;
+
+    if (current_ok && best != current_tier && expectedSeconds(current_tier, view) <= best_seconds * (1.0 + switch_margin))
+        best = current_tier;
+
+    // Without this, a tier whose prior loses to a measured one would never
+    // get the chance to show it's faster
+    if (found && measured_cost.count(best))
+    {
+        double limit = expectedSeconds(best, view) * EXPLORE_RATIO;
+        for (PrecisionTier tier : ALL_TIERS)
+        {
+            if (measured_cost.count(tier) || explored.count(tier) || !supports(tier, view)
+                || headroomBits(tier, view) <= 0.0 || expectedSeconds(tier, view) > limit)
+                continue;
+            explored.insert(tier);
+            best = tier;
+            break;
+        }
+    }
+
+    current_tier = best;
+    planned = true;
+    return current_tier;
+}
+
+void PrecisionPlanner::recordFrame(PrecisionTier tier, const View& view, double seconds)
+{
+    double work = (double)view.width * view.height * view.max_iterations;
+    if (work <= 0.0 || seconds <= 0.0)
+        return;
+    double cost = seconds / work;
+    auto found = measured_cost.find(tier);
+    if (found == measured_cost.end())
+        measured_cost[tier] = cost;
+    else
+        found->second += COST_SMOOTHING * (cost - found->second);
+}
@@ -0,0 +1,79 @@
+#ifndef PRECISION_PLANNER_H
+#define PRECISION_PLANNER_H
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "view.h"
+
+// Every way of rendering a frame, from cheapest to most precise
+enum class PrecisionTier
+{
+    GPU_FLOAT,
+    CPU_FLOAT,
+    CPU_DOUBLE,
+    CPU_FIXED128,
+    CPU_DOUBLE_DOUBLE,
+    PERTURBATION
+};
+
+const std::unordered_map<PrecisionTier, const char*> PRECISION_TIERS = {
+    {PrecisionTier::GPU_FLOAT, "GPU float"},
+    {PrecisionTier::CPU_FLOAT, "CPU float"},
+    {PrecisionTier::CPU_DOUBLE, "CPU double"},
+    {PrecisionTier::CPU_FIXED128, "CPU fixed 4.124"},
+    {PrecisionTier::CPU_DOUBLE_DOUBLE, "CPU double-double"},
+    {PrecisionTier::PERTURBATION, "Perturbation"}
+};
+
+enum class CpuPrecision;
+
+// The tier a CPU engine render in `precision` belongs to
+PrecisionTier cpuPrecisionTier(CpuPrecision precision);
+
+// Picks the tier for each frame: of the tiers whose number type still
+// resolves neighbouring pixels, the one expected to finish first. Costs start
+// from rough priors and follow measured throughput as frames complete.
+//
+// Two kinds of hysteresis keep it from flickering while zooming: a cheaper
+// tier has to clear its precision limit by `hysteresis_bits` before we move
+// back down to it, and a faster-looking tier has to beat the current one by
+// `switch_margin`. Moving to a more precise tier when the current one stops
+// resolving is never delayed. Once the chosen tier has been measured, each
+// unmeasured tier that resolves the view and looks competitive is tried for
+// one frame, so a pessimistic prior can't hide a faster tier for good.
+class PrecisionPlanner
+{
+public:
+    bool gpu_available = true;
+    double hysteresis_bits = 3.0;
+    double switch_margin = 0.25;
+
+    PrecisionTier plan(const View& view);
+
+    // Feeds back how long a frame took on `tier`
+    void recordFrame(PrecisionTier tier, const View& view, double seconds);
+
+    PrecisionTier current() const { return current_tier; }
+
+    // Pixels per second `tier` is expected to reach on `view`
+    double expectedThroughput(PrecisionTier tier, const View& view) const;
+
+    // Whether `tier` can render `view` at all (fractal support, range)
+    bool supports(PrecisionTier tier, const View& view) const;
+
+    // Bits between the tier's rounding error at the view and a pixel; the
+    // tier resolves the view while this is positive
+    static double headroomBits(PrecisionTier tier, const View& view);
+
+private:
+    double expectedSeconds(PrecisionTier tier, const View& view) const;
+
+    PrecisionTier current_tier = PrecisionTier::GPU_FLOAT;
+    bool planned = false;
+    // Measured seconds per pixel-iteration (pixels * max_iterations)
+    std::unordered_map<PrecisionTier, double> measured_cost;
+    std::unordered_set<PrecisionTier> explored; // tried once, even if the frame never finished
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "process_renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "formula_kernels.h"
+
+namespace
+{
+
+// "0-3,8-11" -> 0 1 2 3 8 9 10 11
+std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty() || range[0] < '0' || range[0] > '9')
+            continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+void pinToCpus(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+}
+
+void* mapShared(size_t bytes)
+{
+    void* memory = mmap(nullptr, std::max<size_t>(bytes, 1), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? nullptr : memory;
+}
+
+struct Worker
+{
+    std::vector<int> bands;
+    std::vector<size_t> offsets; // of each band in the segment, in ints
+    std::vector<int> cpus; // its share of its node's CPUs
+    int* segment = nullptr;
+    size_t segment_ints = 0;
+    pid_t pid = -1;
+};
+
+int bandRows(const View& view, int band, int band_height)
+{
+    return std::min(band_height, view.height - band * band_height);
+}
+
+void configure(CpuEngine& engine, const ProcessRenderOptions& options)
+{
+    engine.fill = options.fill;
+    engine.interior = options.interior;
+}
+
+// Runs in the child; never returns
+void runWorker(const View& view, const ProcessRenderOptions& options, const Worker& worker, std::atomic<int>* done)
+{
+    int status = 0;
+    {
+        // Threads inherit the affinity, and the segment's pages are first
+        // touched below, after pinning
+        if (options.pin_to_nodes)
+            pinToCpus(worker.cpus);
+        CpuEngine engine(std::make_shared<TileScheduler>((int)worker.cpus.size()));
+        configure(engine, options);
+        IterationBuffer band;
+        for (size_t i = 0; i < worker.bands.size(); i++)
+        {
+            int first_row = worker.bands[i] * options.band_height;
+            if (!engine.renderBand(view, band, first_row, bandRows(view, worker.bands[i], options.band_height)))
+            {
+                status = 1;
+                break;
+            }
+            std::copy(band.iterations.begin(), band.iterations.end(), worker.segment + worker.offsets[i]);
+            done[worker.bands[i]].store(1, std::memory_order_release);
+        }
+    }
+    // Skip the parent's atexit handlers and static destructors
+    _exit(status);
+}
+
+}
+
+std::vector<std::vector<int>> numaNodeCpus()
+{
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; node++)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file)
+            break;
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus = parseCpuList(list);
+        if (!cpus.empty()) // memory-only nodes have no CPUs
+            nodes.push_back(cpus);
+    }
+
+    if (nodes.empty())
+    {
+        std::vector<int> cpus;
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < std::max(1L, count); cpu++)
+            cpus.push_back(cpu);
+        nodes.push_back(cpus);
+    }
+    return nodes;
+}
+
+bool renderInProcesses(const View& view, IterationBuffer& buffer, const ProcessRenderOptions& options,
+                       ProcessRenderStats* stats)
+{
+    if (view.fractal != Fractal::MANDELBROT && !formulaSpanKernel<double>(view.fractal, options.interior))
+        return false;
+
+    ProcessRenderStats local_stats;
+    ProcessRenderStats& result = stats ? *stats : local_stats;
+    result = ProcessRenderStats();
+
+    std::vector<std::vector<int>> nodes = numaNodeCpus();
+    int band_height = std::max(1, options.band_height);
+    int band_count = (view.height + band_height - 1) / band_height;
+    int process_count = std::max(1, std::min(band_count, options.processes > 0 ? options.processes : (int)nodes.size()));
+    result.nodes = (int)nodes.size();
+    result.processes = process_count;
+
+    ProcessRenderOptions worker_options = options;
+    worker_options.band_height = band_height;
+
+    // Deal bands round robin so every worker gets a mix of cheap and costly rows
+    std::vector<Worker> workers(process_count);
+    for (int band = 0; band < band_count; band++)
+    {
+        Worker& worker = workers[band % process_count];
+        worker.bands.push_back(band);
+        worker.offsets.push_back(worker.segment_ints);
+        worker.segment_ints += (size_t)bandRows(view, band, band_height) * view.width;
+    }
+
+    std::atomic<int>* done = static_cast<std::atomic<int>*>(mapShared(band_count * sizeof(std::atomic<int>)));
+    if (done)
+        for (int band = 0; band < band_count; band++)
+            new (&done[band]) std::atomic<int>(0);
+
+    // Workers on one node split its CPUs instead of each running a thread
+    // per CPU of the node; with more workers than CPUs they share
+    std::vector<int> node_workers(nodes.size(), 0);
+    for (int w = 0; w < process_count; w++)
+        node_workers[w % nodes.size()]++;
+    for (int w = 0; w < process_count; w++)
+    {
+        Worker& worker = workers[w];
+        const std::vector<int>& cpus = nodes[w % nodes.size()];
+        size_t slot = w / nodes.size(), sharing = node_workers[w % nodes.size()];
+        size_t first = cpus.size() * slot / sharing, last = cpus.size() * (slot + 1) / sharing;
+        if (first == last)
+            worker.cpus.assign(1, cpus[slot % cpus.size()]);
+        else
+            worker.cpus.assign(cpus.begin() + first, cpus.begin() + last);
+        worker.segment = done ? static_cast<int*>(mapShared(worker.segment_ints * sizeof(int))) : nullptr;
+        if (!worker.segment)
+            continue;
+        worker.pid = fork();
+        if (worker.pid == 0)
+            runWorker(view, worker_options, worker, done);
+    }
+
+    // Failed workers' bands are redone on as many threads as they had
+    int recovery_threads = 0;
+    for (Worker& worker : workers)
+    {
+        int status = 0;
+        bool succeeded = worker.pid > 0 && waitpid(worker.pid, &status, 0) == worker.pid
+            && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!succeeded)
+        {
+            result.failed_workers++;
+            recovery_threads += (int)worker.cpus.size();
+        }
+    }
+
+    // Assemble, redoing here whatever a failed worker left behind
+    buffer.resize(view.width, view.height);
+    std::unique_ptr<CpuEngine> recovery;
+    IterationBuffer band_buffer;
+    bool rendered = true;
+    for (const Worker& worker : workers)
+    {
+        for (size_t i = 0; i < worker.bands.size(); i++)
+        {
+            int band = worker.bands[i];
+            int rows = bandRows(view, band, band_height);
+            int* destination = &buffer.at(0, band * band_height);
+            if (worker.segment && done[band].load(std::memory_order_acquire))
+            {
+                std::copy(worker.segment + worker.offsets[i], worker.segment + worker.offsets[i] + (size_t)rows * view.width, destination);
+                continue;
+            }
+
+            if (!recovery)
+            {
+                recovery.reset(new CpuEngine(std::make_shared<TileScheduler>(std::max(1, recovery_threads))));
+                configure(*recovery, options);
+            }
+            rendered = recovery->renderBand(view, band_buffer, band * band_height, rows) && rendered;
+            std::copy(band_buffer.iterations.begin(), band_buffer.iterations.end(), destination);
+            result.recovered_bands++;
+        }
+        if (worker.segment)
+            munmap(worker.segment, std::max<size_t>(worker.segment_ints * sizeof(int), 1));
+    }
+    if (done)
+        munmap(done, std::max<size_t>(band_count * sizeof(std::atomic<int>), 1));
+    return rendered;
+}
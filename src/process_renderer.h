@@ -0,0 +1,42 @@
+#ifndef PROCESS_RENDERER_H
+#define PROCESS_RENDERER_H
+
+#include <vector>
+
+#include "cpu_engine.h"
+
+struct ProcessRenderOptions
+{
+    int processes = 0; // 0 means one per NUMA node
+    int band_height = 64;
+    bool pin_to_nodes = true;
+    TileFill fill = TileFill::FULL;
+    InteriorChecks interior;
+};
+
+struct ProcessRenderStats
+{
+    int nodes = 0;
+    int processes = 0;
+    int failed_workers = 0;  // didn't start, crashed or exited with an error
+    int recovered_bands = 0; // left undone by a failed worker and rendered here
+};
+
+// Online CPUs of each NUMA node, from sysfs; a single node with every CPU
+// where the machine reports none
+std::vector<std::vector<int>> numaNodeCpus();
+
+// Renders `view` in forked worker processes, for frames big enough that one
+// process's shared buffers would pay remote memory traffic on a multi-socket
+// machine. Each worker pins itself to its share of a node's CPUs, with a
+// thread per CPU, and renders its bands of rows (dealt round robin) with a
+// CpuEngine into its own shared segment, which it touches first so the pages
+// land on its node. The coordinator copies each finished band into `buffer`;
+// bands a worker didn't mark done, because it crashed or was killed, are
+// rendered again in this process. Returns false if the CPU engine can't
+// render the view.
+bool renderInProcesses(const View& view, IterationBuffer& buffer,
+                       const ProcessRenderOptions& options = ProcessRenderOptions(),
+                       ProcessRenderStats* stats = nullptr);
+
+#endif
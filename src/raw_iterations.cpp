@@ -0,0 +1,338 @@
+#include "raw_iterations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "cpu_engine.h"
+#include "formula_kernels.h"
+#include "fractals.h"
+#include "tile_scheduler.h"
+
+namespace
+{
+
+const char MAGIC[8] = { 'L', 'Z', 'R', 'A', 'W', '0', '1', '\n' };
+const uint32_t VERSION = 1;
+const uint32_t TILE_SIZE = 64;
+const size_t PAGE = 4096;
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+int channelIndex(RawChannel channel)
+{
+    return channel == RAW_ITERATIONS ? 0 : channel == RAW_SMOOTH ? 1 : 2;
+}
+
+// Runs the orbit on to a bailout of 2^16, where log|z| is smooth enough to
+// interpolate the count. False if it never gets there: near the boundary a
+// count from float can disagree with double.
+template <int POWER, bool FOLD>
+bool escapeAt(double cx, double cy, int max_steps, float& smooth, float* distance, double pixel_spacing)
+{
+    const double BAILOUT_SQUARED = 65536.0 * 65536.0;
+    const Complex<double> c = { cx, cy };
+    Complex<double> z = { 0.0, 0.0 }, dz = { 0.0, 0.0 };
+    int i;
+    for (i = 0; i < max_steps; i++)
+    {
+        if (!FOLD)
+        {
+            Complex<double> slope = ComplexPower<POWER - 1>::apply(z) * dz;
+            dz = { POWER * slope.re + 1.0, POWER * slope.im };
+        }
+        z = FOLD ? BurningShipFormula::step<POWER>(z, c) : MandelbrotFormula::step<POWER>(z, c);
+        if (z.re * z.re + z.im * z.im > BAILOUT_SQUARED)
+            break;
+    }
+    if (i == max_steps)
+        return false;
+
+    double magnitude = std::sqrt(z.re * z.re + z.im * z.im);
+    double log_magnitude = std::log(magnitude);
+    smooth = (float)(i + 1 - std::log(log_magnitude) / std::log((double)POWER));
+    if (distance)
+    {
+        double derivative = std::sqrt(dz.re * dz.re + dz.im * dz.im);
+        *distance = (float)(magnitude * log_magnitude / derivative / pixel_spacing);
+    }
+    return true;
+}
+
+template <int POWER, bool FOLD>
+void computeChannels(const View& view, const IterationBuffer& buffer, EscapeChannels& channels)
+{
+    double center_x = view.centerX(), center_y = view.centerY();
+    double pixel_spacing = view.pixelSpacing().toDouble();
+    TileScheduler scheduler;
+    scheduler.run(view.width, view.height, (int)TILE_SIZE, -1.0, -1.0, [&](const Tile& tile, int)
+    {
+        for (int y = tile.y; y < tile.y + tile.height; y++)
+        {
+            double cy = center_y + view.pixelOffsetY(y).toDouble();
+            for (int x = tile.x; x < tile.x + tile.width; x++)
+            {
+                size_t index = (size_t)y * view.width + x;
+                float* distance = FOLD ? nullptr : &channels.distance[index];
+                // Past the last count, only the bailout is left to reach
+                const int RUN_ON = 16;
+                double cx = center_x + view.pixelOffsetX(x).toDouble();
+                if (buffer.at(x, y) >= view.max_iterations
+                    || !escapeAt<POWER, FOLD>(cx, cy, view.max_iterations + RUN_ON, channels.smooth[index], distance,
+                                              pixel_spacing))
+                {
+                    channels.smooth[index] = (float)view.max_iterations;
+                    if (distance)
+                        *distance = 0.0f;
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+bool writeChannel(FILE* file, const RawHeader& header, const std::vector<T>& values)
+{
+    std::vector<T> tile((size_t)header.tile_width * header.tile_height);
+    for (uint32_t tile_y = 0; tile_y < header.tiles_y; tile_y++)
+    {
+        for (uint32_t tile_x = 0; tile_x < header.tiles_x; tile_x++)
+        {
+            std::fill(tile.begin(), tile.end(), T(0));
+            for (uint32_t row = 0; row < header.tile_height; row++)
+            {
+                uint32_t y = tile_y * header.tile_height + row;
+                uint32_t x = tile_x * header.tile_width;
+                if (y >= header.height)
+                    break;
+                uint32_t count = std::min(header.tile_width, header.width - x);
+                std::copy(values.begin() + (size_t)y * header.width + x, values.begin() + (size_t)y * header.width + x + count,
+                          tile.begin() + (size_t)row * header.tile_width);
+            }
+            if (std::fwrite(tile.data(), sizeof(T), tile.size(), file) != tile.size())
+                return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool computeEscapeChannels(const View& view, const IterationBuffer& buffer, EscapeChannels& channels)
+{
+    channels = EscapeChannels();
+    if (!doubleResolvesView(view) || buffer.width != view.width || buffer.height != view.height)
+        return false;
+
+    channels.smooth.resize(buffer.iterations.size());
+    if (view.fractal != Fractal::BURNING_SHIP)
+        channels.distance.resize(buffer.iterations.size());
+    switch (view.fractal)
+    {
+        case Fractal::MULTIBROT3:
+            computeChannels<3, false>(view, buffer, channels);
+            break;
+        case Fractal::BURNING_SHIP:
+            computeChannels<2, true>(view, buffer, channels);
+            break;
+        default:
+            computeChannels<2, false>(view, buffer, channels);
+            break;
+    }
+    return true;
+}
+
+bool writeRawIterations(const std::string& path, const View& view, PrecisionTier tier, const IterationBuffer& buffer,
+                        const EscapeChannels* channels)
+{
+    RawHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.width = buffer.width;
+    header.height = buffer.height;
+    header.tile_width = header.tile_height = TILE_SIZE;
+    header.tiles_x = (header.width + TILE_SIZE - 1) / TILE_SIZE;
+    header.tiles_y = (header.height + TILE_SIZE - 1) / TILE_SIZE;
+    header.fractal = (uint32_t)view.fractal;
+    header.precision_tier = (uint32_t)tier;
+    header.max_iterations = view.max_iterations;
+    header.zoom_mantissa = view.zoom.mantissa;
+    header.zoom_exponent = view.zoom.exponent;
+    header.center_x_length = (uint32_t)view.center_x.size();
+    header.center_y_length = (uint32_t)view.center_y.size();
+    header.header_size = (uint32_t)roundUp(sizeof(header) + view.center_x.size() + view.center_y.size(), PAGE);
+
+    bool smooth = channels && !channels->smooth.empty();
+    bool distance = channels && !channels->distance.empty();
+    header.channels = (uint32_t)RAW_ITERATIONS | (smooth ? (uint32_t)RAW_SMOOTH : 0) | (distance ? (uint32_t)RAW_DISTANCE : 0);
+    size_t channel_bytes = roundUp((size_t)header.tiles_x * header.tiles_y * TILE_SIZE * TILE_SIZE * 4, PAGE);
+    uint64_t offset = header.header_size;
+    for (RawChannel channel : { RAW_ITERATIONS, RAW_SMOOTH, RAW_DISTANCE })
+    {
+        if (!(header.channels & channel))
+            continue;
+        header.channel_offset[channelIndex(channel)] = offset;
+        offset += channel_bytes;
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    std::vector<uint8_t> head(header.header_size, 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    std::memcpy(head.data() + sizeof(header), view.center_x.data(), view.center_x.size());
+    std::memcpy(head.data() + sizeof(header) + view.center_x.size(), view.center_y.data(), view.center_y.size());
+    bool ok = std::fwrite(head.data(), 1, head.size(), file) == head.size();
+    // Channels are whole tiles, which are whole pages, so they end aligned
+    ok = ok && writeChannel(file, header, buffer.iterations);
+    if (smooth)
+        ok = ok && writeChannel(file, header, channels->smooth);
+    if (distance)
+        ok = ok && writeChannel(file, header, channels->distance);
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+RawIterationFile::~RawIterationFile()
+{
+    close();
+}
+
+void RawIterationFile::close()
+{
+#ifdef __unix__
+    if (mapped)
+        munmap(const_cast<uint8_t*>(bytes), size);
+#endif
+    if (!mapped)
+        delete[] bytes;
+    bytes = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+bool RawIterationFile::open(const std::string& path, std::string& error)
+{
+    close();
+#ifdef __unix__
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (descriptor >= 0 && fstat(descriptor, &status) == 0 && status.st_size > 0)
+    {
+        void* map = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (map != MAP_FAILED)
+        {
+            bytes = static_cast<const uint8_t*>(map);
+            size = status.st_size;
+            mapped = true;
+        }
+    }
+    if (descriptor >= 0)
+        ::close(descriptor);
+#endif
+    if (!bytes)
+    {
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        std::streamoff length = stream ? (std::streamoff)stream.tellg() : 0;
+        if (length > 0)
+        {
+            uint8_t* data = new uint8_t[length];
+            stream.seekg(0);
+            if (stream.read(reinterpret_cast<char*>(data), length))
+            {
+                bytes = data;
+                size = length;
+            }
+            else
+                delete[] data;
+        }
+    }
+    if (!bytes)
+    {
+        error = "can't read " + path;
+        return false;
+    }
+
+    // Everything the accessors rely on, so they needn't check
+    bool valid = size >= sizeof(RawHeader);
+    const RawHeader& raw = header();
+    valid = valid && std::memcmp(raw.magic, MAGIC, sizeof(MAGIC)) == 0
+        && raw.version == VERSION && raw.header_size <= size
+        && sizeof(RawHeader) + (uint64_t)raw.center_x_length + raw.center_y_length <= raw.header_size
+        && raw.width > 0 && raw.height > 0 && raw.tile_width == TILE_SIZE && raw.tile_height == TILE_SIZE
+        && raw.tiles_x == ((uint64_t)raw.width + TILE_SIZE - 1) / TILE_SIZE
+        && raw.tiles_y == ((uint64_t)raw.height + TILE_SIZE - 1) / TILE_SIZE
+        && (raw.channels & RAW_ITERATIONS) && raw.max_iterations > 0
+        && FRACTALS.count((Fractal)raw.fractal) && PRECISION_TIERS.count((PrecisionTier)raw.precision_tier);
+    // With 64x64 tiles a row of them is under 2^41 bytes, so only the number
+    // of rows can overflow
+    uint64_t tile_row_bytes = valid ? (uint64_t)raw.tiles_x * TILE_SIZE * TILE_SIZE * 4 : 0;
+    valid = valid && tile_row_bytes > 0 && raw.tiles_y <= size / tile_row_bytes;
+    uint64_t channel_bytes = tile_row_bytes * raw.tiles_y;
+    for (RawChannel channel : { RAW_ITERATIONS, RAW_SMOOTH, RAW_DISTANCE })
+    {
+        if (!valid || !(raw.channels & channel))
+            continue;
+        uint64_t offset = raw.channel_offset[channelIndex(channel)];
+        valid = offset >= raw.header_size && offset % 4 == 0 && offset <= size && channel_bytes <= size - offset;
+    }
+    if (!valid)
+    {
+        close();
+        error = path + " isn't a raw iteration file this version reads";
+        return false;
+    }
+    return true;
+}
+
+View RawIterationFile::view() const
+{
+    const RawHeader& raw = header();
+    const char* text = reinterpret_cast<const char*>(bytes + sizeof(RawHeader));
+    View result;
+    result.fractal = (Fractal)raw.fractal;
+    result.center_x.assign(text, raw.center_x_length);
+    result.center_y.assign(text + raw.center_x_length, raw.center_y_length);
+    result.zoom.mantissa = raw.zoom_mantissa;
+    result.zoom.exponent = raw.zoom_exponent;
+    result.width = raw.width;
+    result.height = raw.height;
+    result.max_iterations = raw.max_iterations;
+    return result;
+}
+
+const void* RawIterationFile::tile(RawChannel channel, int tile_x, int tile_y) const
+{
+    const RawHeader& raw = header();
+    size_t tile_bytes = (size_t)raw.tile_width * raw.tile_height * 4;
+    return bytes + raw.channel_offset[channelIndex(channel)] + ((size_t)tile_y * raw.tiles_x + tile_x) * tile_bytes;
+}
+
+const void* RawIterationFile::pixel(RawChannel channel, int x, int y) const
+{
+    const RawHeader& raw = header();
+    const uint8_t* start = static_cast<const uint8_t*>(tile(channel, x / raw.tile_width, y / raw.tile_height));
+    return start + ((size_t)(y % raw.tile_height) * raw.tile_width + x % raw.tile_width) * 4;
+}
+
+void RawIterationFile::copyIterations(IterationBuffer& buffer) const
+{
+    const RawHeader& raw = header();
+    buffer.resize(raw.width, raw.height);
+    for (uint32_t y = 0; y < raw.height; y++)
+        for (uint32_t x = 0; x < raw.width; x++)
+            buffer.at(x, y) = iterations(x, y);
+}
@@ -0,0 +1,138 @@
+#ifndef RAW_ITERATIONS_H
+#define RAW_ITERATIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "iteration_buffer.h"
+#include "precision_planner.h"
+#include "view.h"
+
+// Raw iteration files (.lzr): a render's per-pixel data plus everything needed
+// to know what it shows, laid out so a reader can mmap the file and index it
+// directly. Little-endian throughout.
+//
+//   offset  size  field
+//   0       8     magic "LZRAW01\n"
+//   8       4     version (1)
+//   12      4     header size: where the first channel may start; a multiple
+//                 of 4096 holding this table and the center text
+//   16      4     width
+//   20      4     height
+//   24      4     tile width  (64; version 1 readers accept nothing else)
+//   28      4     tile height (64)
+//   32      4     tiles across, ceil(width / tile width)
+//   36      4     tiles down, ceil(height / tile height)
+//   40      4     channel mask: RAW_ITERATIONS | RAW_SMOOTH | RAW_DISTANCE
+//   44      4     fractal (Fractal enum value)
+//   48      4     precision tier (PrecisionTier enum value)
+//   52      4     maximum iterations
+//   56      8     zoom mantissa, double
+//   64      4     zoom exponent, base 2
+//   68      4     center x length, bytes
+//   72      4     center y length, bytes
+//   76      4     reserved, 0
+//   80      3x8   offset of each channel (iterations, smooth, distance), 0
+//                 when absent; multiples of 4096
+//   104     ...   center x decimal text, then center y, unterminated
+//
+// Each channel is tiles down x tiles across tiles of tile width x tile height
+// 4-byte values, tiles in row-major order from the bottom left, pixels within
+// a tile row-major from its bottom row, matching IterationBuffer. Edge tiles
+// are stored whole; the pixels past the image are 0. A 64x64 tile is 16 KB,
+// so every tile starts on a page.
+//
+//   iterations  int32: index of the escaping iteration, or the maximum
+//   smooth      float: continuous escape count, n + 1 - log_p(log|z_n|) after
+//               running on to a large bailout; the maximum for interior pixels
+//   distance    float: distance estimate to the set, |z| log|z| / |dz/dc|, in
+//               units of the pixel spacing (zoom / max(width, height)) so it
+//               stays in float's range at any depth; 0 for interior pixels
+
+enum RawChannel : uint32_t
+{
+    RAW_ITERATIONS = 1,
+    RAW_SMOOTH = 2,
+    RAW_DISTANCE = 4
+};
+
+struct RawHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t width, height;
+    uint32_t tile_width, tile_height;
+    uint32_t tiles_x, tiles_y;
+    uint32_t channels;
+    uint32_t fractal;
+    uint32_t precision_tier;
+    int32_t max_iterations;
+    double zoom_mantissa;
+    int32_t zoom_exponent;
+    uint32_t center_x_length, center_y_length;
+    uint32_t reserved;
+    uint64_t channel_offset[3];
+};
+
+static_assert(sizeof(RawHeader) == 104, "RawHeader must match the documented layout");
+
+// Smooth escape and distance estimate channels, row-major like IterationBuffer
+struct EscapeChannels
+{
+    std::vector<float> smooth;
+    std::vector<float> distance; // empty for formulas without a derivative (Burning Ship)
+};
+
+// Re-iterates every escaped pixel of `buffer` in double to fill `channels`,
+// on the tile pool. False, leaving them empty, once double can't resolve the
+// view.
+bool computeEscapeChannels(const View& view, const IterationBuffer& buffer, EscapeChannels& channels);
+
+// Writes a render; `channels` may be null or partly empty
+bool writeRawIterations(const std::string& path, const View& view, PrecisionTier tier, const IterationBuffer& buffer,
+                        const EscapeChannels* channels = nullptr);
+
+// A raw iteration file mapped read-only (read into memory where there's no
+// mmap); nothing is parsed past the header checks
+class RawIterationFile
+{
+public:
+    RawIterationFile() {}
+    ~RawIterationFile();
+
+    RawIterationFile(const RawIterationFile&) = delete;
+    RawIterationFile& operator=(const RawIterationFile&) = delete;
+
+    // False, with a message in `error`, if the file isn't a valid one
+    bool open(const std::string& path, std::string& error);
+
+    const RawHeader& header() const { return *reinterpret_cast<const RawHeader*>(bytes); }
+    bool has(RawChannel channel) const { return (header().channels & channel) != 0; }
+
+    // The view it was rendered from, center digits and all
+    View view() const;
+    PrecisionTier tier() const { return (PrecisionTier)header().precision_tier; }
+
+    // One tile of a channel the file has, tile width x tile height values
+    const void* tile(RawChannel channel, int tile_x, int tile_y) const;
+
+    int iterations(int x, int y) const { return *static_cast<const int32_t*>(pixel(RAW_ITERATIONS, x, y)); }
+    float smooth(int x, int y) const { return *static_cast<const float*>(pixel(RAW_SMOOTH, x, y)); }
+    float distance(int x, int y) const { return *static_cast<const float*>(pixel(RAW_DISTANCE, x, y)); }
+
+    // Untiles the iteration channel
+    void copyIterations(IterationBuffer& buffer) const;
+
+private:
+    const void* pixel(RawChannel channel, int x, int y) const;
+    void close();
+
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+};
+
+#endif
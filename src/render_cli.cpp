@@ -0,0 +1,348 @@
+// leibniz-render: renders one view to an image without opening a window
+//
+//   leibniz-render --center-x -0.743643887037 --center-y 0.131825904205
+//                  --zoom 1e-9 --iterations 5000 --output spiral.png
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "auto_engine.h"
+#include "checkpoint.h"
+#include "cpu_engine.h"
+#include "image_writer.h"
+#include "job_renderer.h"
+#include "perturbation_engine.h"
+#include "raw_iterations.h"
+#include "render_options.h"
+#include "strip_renderer.h"
+#include "video_writer.h"
+#include "zoom_video.h"
+#ifdef __unix__
+#include "process_renderer.h"
+#endif
+
+namespace
+{
+
+void printUsage(FILE* file)
+{
+    std::fprintf(file, "usage: leibniz-render [--key value | --key=value]...\n\n%s"
+                 "  jobs                 file of renders, one per line as key=value settings, run\n"
+                 "                       in this process; the other options are their defaults\n"
+                 "  concurrent-jobs      jobs of the file in flight at once (2)\n", RENDER_OPTIONS_HELP);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Renders with whichever engine the job names; `detail` says how and `tier`
+// what the counts were computed in
+bool renderJob(const RenderJob& job, IterationBuffer& buffer, std::string& detail, PrecisionTier& tier)
+{
+#ifdef __unix__
+    if (job.engine == EngineType::CPU && job.processes != 1)
+    {
+        ProcessRenderOptions options;
+        options.processes = job.processes;
+        options.fill = job.fill;
+        options.interior = job.interior;
+        ProcessRenderStats stats;
+        bool rendered = renderInProcesses(job.view, buffer, options, &stats);
+        tier = cpuPrecisionTier(cpuPrecisionFor(job.view, job.interior));
+        detail = std::to_string(stats.processes) + " processes on " + std::to_string(stats.nodes) + " nodes";
+        if (stats.failed_workers)
+            detail += ", " + std::to_string(stats.recovered_bands) + " bands recovered";
+        return rendered;
+    }
+#endif
+    JobRenderer renderer;
+    return renderer.render(job, buffer, detail, tier);
+}
+
+// Every job of a job file in this one process
+int renderJobFile(const std::string& path, const RenderJob& defaults, int concurrent_jobs)
+{
+    std::vector<RenderJob> jobs;
+    std::string error;
+    if (!parseJobFile(path, defaults, jobs, error))
+    {
+        std::fprintf(stderr, "leibniz-render: %s\n", error.c_str());
+        return 2;
+    }
+
+    BatchOptions options;
+    options.concurrent_jobs = concurrent_jobs;
+    BatchStats stats;
+    int finished = 0;
+    renderBatch(jobs, options, &stats, [&](const BatchJobReport& report)
+    {
+        std::fprintf(stderr, "[%d/%d] %s: %s, %.3f s\n", ++finished, (int)jobs.size(),
+                     jobs[report.index].output.c_str(), report.message.c_str(), report.seconds);
+    });
+    std::fprintf(stderr, "%d jobs in %.3f s, %d failed; %d primary references reused, %d computed\n", stats.jobs,
+                 stats.seconds, stats.failed, stats.reference_hits, stats.reference_misses);
+    return stats.failed ? 1 : 0;
+}
+
+// Re-exports the image saved in a raw iteration file, no rendering involved
+int exportRaw(const RenderJob& job)
+{
+    RawIterationFile file;
+    std::string error;
+    if (!file.open(job.from_raw, error))
+    {
+        std::fprintf(stderr, "leibniz-render: %s\n", error.c_str());
+        return 1;
+    }
+    View view = file.view();
+    IterationBuffer buffer;
+    auto start = std::chrono::steady_clock::now();
+    file.copyIterations(buffer);
+    if (!writeImage(job.output, buffer, view.max_iterations))
+    {
+        std::fprintf(stderr, "leibniz-render: couldn't write %s\n", job.output.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "%s %dx%d from %s (%s%s%s): write %.3f s\n", FRACTALS.at(view.fractal), view.width,
+                 view.height, job.from_raw.c_str(), PRECISION_TIERS.at(file.tier()),
+                 file.has(RAW_SMOOTH) ? ", smooth" : "", file.has(RAW_DISTANCE) ? ", distance" : "",
+                 secondsSince(start));
+    return 0;
+}
+
+// Strip by strip, straight to the file
+int renderStreamed(const RenderJob& job)
+{
+    if (job.engine != EngineType::CPU || job.processes != 1)
+    {
+        std::fprintf(stderr, "leibniz-render: strips and supersampling need the CPU engine in one process\n");
+        return 2;
+    }
+    std::unique_ptr<ImageWriter> writer = openImageWriter(job.output, job.view.width, job.view.height);
+    if (!writer)
+    {
+        std::fprintf(stderr, "leibniz-render: couldn't write %s\n", job.output.c_str());
+        return 1;
+    }
+
+    StripRenderOptions options;
+    options.strip_rows = job.strip_rows;
+    options.supersample = job.supersample;
+    options.adaptive_samples = job.adaptive_samples;
+    options.fill = job.fill;
+    options.interior = job.interior;
+    StripRenderStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (!renderStrips(job.view, *writer, options, &stats))
+    {
+        std::fprintf(stderr, "leibniz-render: couldn't render or write %s\n", job.output.c_str());
+        return 1;
+    }
+    double seconds = secondsSince(start);
+
+    double pixels = (double)job.view.width * job.view.height;
+    char sampling[96];
+    if (job.adaptive_samples > 1)
+        std::snprintf(sampling, sizeof(sampling), "up to %d samples at %.1f%% edge pixels, %.2f per pixel",
+                      job.adaptive_samples, 100.0 * stats.edge_pixels / pixels, stats.samples / pixels);
+    else
+        std::snprintf(sampling, sizeof(sampling), "%dx%d samples", job.supersample, job.supersample);
+    std::fprintf(stderr, "%s %dx%d, %d strips of %d rows, %s: %.3f s (%.2f Mpixel/s), "
+                 "%.3f s waiting on writes, peak %.1f MB\n",
+                 FRACTALS.at(job.view.fractal), job.view.width, job.view.height, stats.strips, stats.strip_rows,
+                 sampling, seconds, pixels / seconds * 1e-6, stats.write_wait_seconds, stats.peak_bytes / 1048576.0);
+    return 0;
+}
+
+// Frame after frame, straight to the video
+int renderVideo(const RenderJob& job)
+{
+    if (job.video_mode == ZoomVideoMode::EXPONENTIAL_MAP && job.zoom_start.log2() < job.view.zoom.log2())
+    {
+        std::fprintf(stderr, "leibniz-render: exp-map videos only zoom in; zoom-start must be at least zoom\n");
+        return 2;
+    }
+    std::unique_ptr<VideoWriter> writer = openVideoWriter(job.output, job.view.width, job.view.height, job.fps);
+    if (!writer)
+    {
+        std::fprintf(stderr, "leibniz-render: videos go to a .y4m file, - or a pattern like frame%%05d.png, "
+                     "not %s\n", job.output.c_str());
+        return 2;
+    }
+
+    ZoomVideoOptions options;
+    options.mode = job.video_mode;
+    options.start_zoom = job.zoom_start;
+    options.frames = job.frames;
+    options.fill = job.fill;
+    options.interior = job.interior;
+    ZoomVideoStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (!renderZoomVideo(job.view, options, *writer, &stats))
+    {
+        std::fprintf(stderr, "leibniz-render: couldn't render or write the video (zooms past double are "
+                     "Mandelbrot only)\n");
+        return 1;
+    }
+    double seconds = secondsSince(start);
+
+    std::fprintf(stderr, "%s %dx%d, %s video: %d frames in %.3f s (%.2f s per frame), %d references, "
+                 "%.1f Mpoints\n",
+                 FRACTALS.at(job.view.fractal), job.view.width, job.view.height, ZOOM_VIDEO_MODES.at(job.video_mode),
+                 stats.frames, seconds, seconds / std::max(1, stats.frames), stats.references, stats.points * 1e-6);
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    RenderJob job;
+    std::string job_file;
+    int concurrent_jobs = 2;
+#ifdef LEIBNIZ_SHADER_DIRECTORY
+    job.shader_directory = LEIBNIZ_SHADER_DIRECTORY; // the source tree's, so it runs from anywhere
+#endif
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "-h" || argument == "--help")
+        {
+            printUsage(stdout);
+            return 0;
+        }
+        if (argument.compare(0, 2, "--") != 0)
+        {
+            std::fprintf(stderr, "leibniz-render: unexpected argument '%s'\n", argument.c_str());
+            printUsage(stderr);
+            return 2;
+        }
+
+        std::string key = argument.substr(2), value;
+        size_t equals = key.find('=');
+        if (equals != std::string::npos)
+        {
+            value = key.substr(equals + 1);
+            key.resize(equals);
+        }
+        else if (i + 1 < argc)
+            value = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "leibniz-render: --%s needs a value\n", key.c_str());
+            return 2;
+        }
+
+        if (key == "jobs")
+        {
+            job_file = value;
+            continue;
+        }
+        if (key == "concurrent-jobs")
+        {
+            char* end;
+            concurrent_jobs = (int)std::strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end || concurrent_jobs < 1)
+            {
+                std::fprintf(stderr, "leibniz-render: concurrent-jobs must be a positive integer, not '%s'\n",
+                             value.c_str());
+                return 2;
+            }
+            continue;
+        }
+
+        std::string error;
+        if (!applyRenderOption(job, key, value, error))
+        {
+            std::fprintf(stderr, "leibniz-render: %s\n", error.c_str());
+            return 2;
+        }
+    }
+
+    if (!job_file.empty())
+        return renderJobFile(job_file, job, concurrent_jobs);
+    if (!job.from_raw.empty())
+        return exportRaw(job);
+    if (job.supersample > 1 && job.adaptive_samples > 1)
+    {
+        std::fprintf(stderr, "leibniz-render: supersample and adaptive-samples are alternatives; pick one\n");
+        return 2;
+    }
+    if (!job.raw.empty() && (job.video || job.stream || job.supersample > 1 || job.adaptive_samples > 1))
+    {
+        std::fprintf(stderr, "leibniz-render: raw files hold one frame's buffer, so no videos, strips or "
+                     "supersampling\n");
+        return 2;
+    }
+    if (job.video)
+        return renderVideo(job);
+
+    bool checkpointed = !job.checkpoint.empty();
+    if (checkpointed && (job.stream || job.supersample > 1 || job.adaptive_samples > 1))
+    {
+        std::fprintf(stderr, "leibniz-render: checkpoints don't combine with strips or supersampling\n");
+        return 2;
+    }
+    if (!checkpointed && job.raw.empty() && job.streams())
+        return renderStreamed(job);
+
+    auto start = std::chrono::steady_clock::now();
+    IterationBuffer buffer;
+    std::string detail;
+    PrecisionTier tier = PrecisionTier::CPU_DOUBLE;
+    if (checkpointed)
+    {
+        CheckpointOptions options;
+        options.path = job.checkpoint;
+        CheckpointStats stats;
+        if (!renderCheckpointed(job, buffer, options, &stats, detail))
+        {
+            std::fprintf(stderr, "leibniz-render: %s\n", detail.c_str());
+            return 1;
+        }
+        detail = std::to_string(stats.resumed_bands) + " of " + std::to_string(stats.bands) + " bands resumed";
+        if (stats.resumed_reference)
+            detail += " with the reference";
+        tier = stats.tier;
+    }
+    else if (!renderJob(job, buffer, detail, tier))
+    {
+        std::fprintf(stderr, "leibniz-render: %s engine can't render this view (%s)\n",
+                     ENGINES.at(job.engine), detail.c_str());
+        return 1;
+    }
+    double render_seconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    if (!writeImage(job.output, buffer, job.view.max_iterations))
+    {
+        std::fprintf(stderr, "leibniz-render: couldn't write %s\n", job.output.c_str());
+        return 1;
+    }
+    if (!job.raw.empty())
+    {
+        EscapeChannels channels;
+        bool escape = computeEscapeChannels(job.view, buffer, channels);
+        if (!writeRawIterations(job.raw, job.view, tier, buffer, escape ? &channels : nullptr))
+        {
+            std::fprintf(stderr, "leibniz-render: couldn't write %s\n", job.raw.c_str());
+            return 1;
+        }
+    }
+    double write_seconds = secondsSince(start);
+    if (checkpointed)
+        std::remove(job.checkpoint.c_str());
+
+    // Timing goes to stderr so stdout can carry the image
+    double pixels = (double)job.view.width * job.view.height;
+    std::fprintf(stderr, "%s %dx%d, %s (%s): render %.3f s (%.2f Mpixel/s), write %.3f s\n",
+                 FRACTALS.at(job.view.fractal), job.view.width, job.view.height, ENGINES.at(job.engine), detail.c_str(),
+                 render_seconds, pixels / render_seconds * 1e-6, write_seconds);
+    return 0;
+}
@@ -0,0 +1,350 @@
+#include "render_options.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+
+const std::unordered_map<std::string, Fractal> FRACTAL_KEYS = {
+    {"mandelbrot", Fractal::MANDELBROT},
+    {"multibrot3", Fractal::MULTIBROT3},
+    {"burning-ship", Fractal::BURNING_SHIP}
+};
+
+const std::unordered_map<std::string, EngineType> ENGINE_KEYS = {
+    {"gpu", EngineType::GPU},
+    {"cpu", EngineType::CPU},
+    {"perturbation", EngineType::PERTURBATION},
+    {"auto", EngineType::AUTO},
+    {"hybrid", EngineType::HYBRID}
+};
+
+const std::unordered_map<std::string, ZoomVideoMode> VIDEO_KEYS = {
+    {"frames", ZoomVideoMode::FRAMES},
+    {"exp-map", ZoomVideoMode::EXPONENTIAL_MAP}
+};
+
+const std::unordered_map<std::string, TileFill> FILL_KEYS = {
+    {"full", TileFill::FULL},
+    {"mariani-silver", TileFill::MARIANI_SILVER},
+    {"boundary-trace", TileFill::BOUNDARY_TRACE}
+};
+
+template <typename T>
+bool lookup(const std::unordered_map<std::string, T>& keys, const std::string& key, const std::string& value,
+            T& result, std::string& error)
+{
+    auto found = keys.find(value);
+    if (found != keys.end())
+    {
+        result = found->second;
+        return true;
+    }
+    error = "unknown " + key + " '" + value + "' (expected";
+    for (const auto& pair : keys)
+        error += " " + pair.first;
+    error += ")";
+    return false;
+}
+
+template <typename T>
+const char* keyFor(const std::unordered_map<std::string, T>& keys, T value)
+{
+    for (const auto& pair : keys)
+        if (pair.second == value)
+            return pair.first.c_str();
+    return "";
+}
+
+bool parseInt(const std::string& key, const std::string& value, int minimum, int& result, std::string& error)
+{
+    char* end;
+    errno = 0;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end || errno || parsed < minimum || parsed > 1 << 30)
+    {
+        error = key + " must be an integer of at least " + std::to_string(minimum) + ", not '" + value + "'";
+        return false;
+    }
+    result = (int)parsed;
+    return true;
+}
+
+// Counts the decimal digits from `i` on
+size_t skipDigits(const std::string& text, size_t& i)
+{
+    size_t start = i;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+        i++;
+    return i - start;
+}
+
+// What MpReal::fromString() and friends read: an optional sign, digits with
+// an optional point, and an optional exponent. Not inf, nan or hex floats,
+// which they'd silently take as 0.
+bool isDecimal(const std::string& text)
+{
+    size_t i = 0;
+    if (i < text.size() && (text[i] == '-' || text[i] == '+'))
+        i++;
+    size_t digits = skipDigits(text, i);
+    if (i < text.size() && text[i] == '.')
+        digits += skipDigits(text, ++i);
+    if (digits == 0)
+        return false;
+    if (i < text.size() && (text[i] == 'e' || text[i] == 'E'))
+    {
+        i++;
+        if (i < text.size() && (text[i] == '-' || text[i] == '+'))
+            i++;
+        if (skipDigits(text, i) == 0)
+            return false;
+    }
+    return i == text.size();
+}
+
+// Checks the text is a decimal number, but keeps every digit the user gave
+bool parseCenter(const std::string& key, const std::string& value, std::string& result, std::string& error)
+{
+    if (!isDecimal(value))
+    {
+        error = key + " must be a decimal number, not '" + value + "'";
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+bool parseInterior(const std::string& value, InteriorChecks& interior, std::string& error)
+{
+    InteriorChecks parsed;
+    parsed.cardioid = parsed.periodicity = parsed.derivative = false;
+    std::stringstream stream(value);
+    std::string check;
+    while (std::getline(stream, check, ','))
+    {
+        if (check == "cardioid")
+            parsed.cardioid = true;
+        else if (check == "periodicity")
+            parsed.periodicity = true;
+        else if (check == "derivative")
+            parsed.derivative = true;
+        else if (check != "none")
+        {
+            error = "unknown interior check '" + check + "' (expected cardioid, periodicity, derivative or none)";
+            return false;
+        }
+    }
+    interior = parsed;
+    return true;
+}
+
+}
+
+const char* RENDER_OPTIONS_HELP =
+    "  center-x, center-y   decimal center, any number of digits (0, 0)\n"
+    "  zoom                 extent of the view along each axis, e.g. 1e-40 (2)\n"
+    "  width, height        size in pixels (1920 x 1080)\n"
+    "  iterations           maximum iteration count (1000)\n"
+    "  fractal              mandelbrot, multibrot3 or burning-ship\n"
+    "  engine               cpu, perturbation, auto, gpu or hybrid\n"
+    "  fill                 full, mariani-silver or boundary-trace (CPU engines)\n"
+    "  interior             comma list of cardioid, periodicity, derivative, or none\n"
+    "  processes            CPU engine worker processes; 0 is one per NUMA node (1)\n"
+    "  strip-rows           render and write this many rows at a time (CPU engine);\n"
+    "                       0 sizes strips to memory, and is the default past 256 Mpixel\n"
+    "  supersample          samples per pixel along each axis, box-filtered; renders\n"
+    "                       in strips like strip-rows (1)\n"
+    "  adaptive-samples     up to this many jittered samples for pixels on edges, one\n"
+    "                       for the rest; renders in strips like strip-rows (0, off)\n"
+    "  output               .png, .tif or .ppm path, - for PPM on stdout\n"
+    "  shaders              directory holding the GPU engine's shaders\n"
+    "  checkpoint           file saving progress as bands finish; rerunning the same\n"
+    "                       job resumes from it, and it's deleted once the image is out\n"
+    "  raw                  also save the counts, plus smooth and distance estimate\n"
+    "                       channels where double resolves the view, to this .lzr file\n"
+    "  from-raw             export the image from a .lzr file instead of rendering\n"
+    "  video                frames or exp-map: render a zoom video from zoom-start to\n"
+    "                       zoom, output to .y4m, - (Y4M on stdout) or frame%05d.png\n"
+    "  zoom-start           the video's first zoom (2)\n"
+    "  frames               video frames, evenly spaced in log zoom (30 per octave)\n"
+    "  fps                  Y4M frame rate (30)\n";
+
+bool RenderJob::streams() const
+{
+    const double STREAM_PIXELS = 256e6; // a gigabyte of iteration counts
+    bool huge = engine == EngineType::CPU && processes == 1 && (double)view.width * view.height > STREAM_PIXELS;
+    return stream || supersample > 1 || adaptive_samples > 1 || huge;
+}
+
+bool parseFloatExp(const std::string& text, floatexp& value)
+{
+    // Split off the decimal exponent so it can exceed double's
+    size_t e = text.find_first_of("eE");
+    std::string mantissa_text = text.substr(0, e);
+    char* end;
+    double mantissa = std::strtod(mantissa_text.c_str(), &end);
+    if (mantissa_text.empty() || *end || !std::isfinite(mantissa))
+        return false;
+
+    long exponent10 = 0;
+    if (e != std::string::npos)
+    {
+        std::string exponent_text = text.substr(e + 1);
+        errno = 0;
+        exponent10 = std::strtol(exponent_text.c_str(), &end, 10);
+        if (exponent_text.empty() || *end || errno || std::labs(exponent10) > 100000000)
+            return false;
+    }
+    value = floatexp(mantissa) * floatexp::fromLog2(exponent10 * std::log2(10.0));
+    return true;
+}
+
+std::string formatFloatExp(const floatexp& value)
+{
+    if (value.isZero())
+        return "0";
+    // Split log10 into a decimal exponent and a mantissa in [1, 10)
+    double log10_value = value.log2() * std::log10(2.0);
+    long exponent10 = (long)std::floor(log10_value);
+    double mantissa = std::pow(10.0, log10_value - exponent10);
+    if (mantissa >= 10.0)
+    {
+        mantissa /= 10.0;
+        exponent10++;
+    }
+    char text[64];
+    std::snprintf(text, sizeof(text), "%s%.17ge%ld", value.mantissa < 0 ? "-" : "", mantissa, exponent10);
+    return text;
+}
+
+std::string describeRenderJob(const RenderJob& job)
+{
+    std::string interior;
+    if (job.interior.cardioid)
+        interior += "cardioid,";
+    if (job.interior.periodicity)
+        interior += "periodicity,";
+    if (job.interior.derivative)
+        interior += "derivative,";
+    interior = interior.empty() ? "none" : interior.substr(0, interior.size() - 1);
+
+    return "fractal=" + std::string(keyFor(FRACTAL_KEYS, job.view.fractal)) + "\n"
+        + "center-x=" + job.view.center_x + "\n"
+        + "center-y=" + job.view.center_y + "\n"
+        + "zoom=" + formatFloatExp(job.view.zoom) + "\n"
+        + "width=" + std::to_string(job.view.width) + "\n"
+        + "height=" + std::to_string(job.view.height) + "\n"
+        + "iterations=" + std::to_string(job.view.max_iterations) + "\n"
+        + "engine=" + keyFor(ENGINE_KEYS, job.engine) + "\n"
+        + "fill=" + keyFor(FILL_KEYS, job.fill) + "\n"
+        + "interior=" + interior + "\n";
+}
+
+bool applyRenderOption(RenderJob& job, const std::string& key, const std::string& value, std::string& error)
+{
+    if (key == "center-x")
+        return parseCenter(key, value, job.view.center_x, error);
+    if (key == "center-y")
+        return parseCenter(key, value, job.view.center_y, error);
+    if (key == "zoom")
+    {
+        floatexp zoom;
+        if (!parseFloatExp(value, zoom) || !(zoom.mantissa > 0))
+        {
+            error = "zoom must be a positive decimal number, not '" + value + "'";
+            return false;
+        }
+        job.view.zoom = zoom;
+        return true;
+    }
+    if (key == "width")
+        return parseInt(key, value, 1, job.view.width, error);
+    if (key == "height")
+        return parseInt(key, value, 1, job.view.height, error);
+    if (key == "iterations")
+        return parseInt(key, value, 1, job.view.max_iterations, error);
+    if (key == "processes")
+        return parseInt(key, value, 0, job.processes, error);
+    if (key == "strip-rows")
+    {
+        if (!parseInt(key, value, 0, job.strip_rows, error))
+            return false;
+        job.stream = true;
+        return true;
+    }
+    if (key == "supersample")
+        return parseInt(key, value, 1, job.supersample, error);
+    if (key == "adaptive-samples")
+        return parseInt(key, value, 0, job.adaptive_samples, error);
+    if (key == "fractal")
+        return lookup(FRACTAL_KEYS, key, value, job.view.fractal, error);
+    if (key == "engine")
+        return lookup(ENGINE_KEYS, key, value, job.engine, error);
+    if (key == "fill")
+        return lookup(FILL_KEYS, key, value, job.fill, error);
+    if (key == "interior")
+        return parseInterior(value, job.interior, error);
+    if (key == "output")
+    {
+        if (value.empty())
+        {
+            error = "output can't be empty";
+            return false;
+        }
+        job.output = value;
+        return true;
+    }
+    if (key == "video")
+    {
+        job.video = true;
+        return lookup(VIDEO_KEYS, key, value, job.video_mode, error);
+    }
+    if (key == "zoom-start")
+    {
+        floatexp zoom;
+        if (!parseFloatExp(value, zoom) || !(zoom.mantissa > 0))
+        {
+            error = "zoom-start must be a positive decimal number, not '" + value + "'";
+            return false;
+        }
+        job.zoom_start = zoom;
+        return true;
+    }
+    if (key == "frames")
+        return parseInt(key, value, 1, job.frames, error);
+    if (key == "fps")
+        return parseInt(key, value, 1, job.fps, error);
+    if (key == "checkpoint")
+    {
+        job.checkpoint = value;
+        return true;
+    }
+    if (key == "raw" || key == "from-raw")
+    {
+        if (value.empty())
+        {
+            error = key + " can't be empty";
+            return false;
+        }
+        (key == "raw" ? job.raw : job.from_raw) = value;
+        return true;
+    }
+    if (key == "shaders")
+    {
+        if (value.empty())
+        {
+            error = "shaders can't be empty";
+            return false;
+        }
+        job.shader_directory = value;
+        return true;
+    }
+    error = "unknown option '" + key + "'";
+    return false;
+}
@@ -0,0 +1,68 @@
+#ifndef RENDER_OPTIONS_H
+#define RENDER_OPTIONS_H
+
+#include <string>
+
+#include "cpu_engine.h"
+#include "engine.h"
+#include "view.h"
+#include "zoom_video.h"
+
+// One render as the command line (and anything else that takes key/value
+// settings) describes it
+struct RenderJob
+{
+    View view;
+    EngineType engine = EngineType::CPU;
+    TileFill fill = TileFill::FULL;
+    InteriorChecks interior;
+    int processes = 1; // CPU engine only; 0 means one per NUMA node
+    // Streaming in strips (CPU engine, one process): rows per strip, 0 to
+    // size them to memory, and samples per pixel along each axis
+    bool stream = false;
+    int strip_rows = 0;
+    int supersample = 1;
+    int adaptive_samples = 0; // at most, for edge pixels only; 0 for none
+    std::string output = "leibniz.png";
+    std::string checkpoint; // resumable progress file; empty for none
+    // Raw iteration file (.lzr) written alongside the image, and one to
+    // export the image from instead of rendering; empty for none
+    std::string raw;
+    std::string from_raw;
+    // A zoom video from zoom_start down to the view's zoom instead of one image
+    bool video = false;
+    ZoomVideoMode video_mode = ZoomVideoMode::FRAMES;
+    floatexp zoom_start = floatexp(2.0);
+    int frames = 0; // 0 means 30 per octave
+    int fps = 30;
+    std::string shader_directory = "../shaders"; // GPU, hybrid and auto engines
+
+    // Whether the job renders strip by strip rather than into one buffer:
+    // when asked to, for either kind of supersampling, and for CPU frames too
+    // big to hold
+    bool streams() const;
+
+    RenderJob()
+    {
+        view.width = 1920;
+        view.height = 1080;
+        view.max_iterations = 1000;
+    }
+};
+
+// Applies one setting, e.g. "zoom" = "1e-30". Returns false, with a message
+// in `error`, for unknown keys and bad values.
+bool applyRenderOption(RenderJob& job, const std::string& key, const std::string& value, std::string& error);
+
+// Decimal text such as "1.5e-400", past double's range if need be
+bool parseFloatExp(const std::string& text, floatexp& value);
+std::string formatFloatExp(const floatexp& value);
+
+// The settings that decide the job's pixels, as "key=value" lines that
+// applyRenderOption() takes back; equal text means the same image
+std::string describeRenderJob(const RenderJob& job);
+
+// One line per key, for usage messages
+extern const char* RENDER_OPTIONS_HELP;
+
+#endif
@@ -0,0 +1,129 @@
+#include "render_thread.h"
+
+#include <algorithm>
+#include <chrono>
+
+RenderThread::RenderThread(std::function<void()> attach_context)
+    : scheduler(std::make_shared<TileScheduler>()),
+      cpu_engine(scheduler),
+      perturbation_engine(scheduler),
+      auto_engine(false, scheduler),
+      attach_context(attach_context)
+{
+    cpu_engine.setCancelFlag(&cancel);
+    perturbation_engine.setCancelFlag(&cancel);
+    auto_engine.setCancelFlag(&cancel);
+    thread = std::thread(&RenderThread::loop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        cancel = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void RenderThread::submit(const RenderRequest& request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_request = request;
+        pending = true;
+        cancel = true;
+    }
+    wake.notify_one();
+}
+
+bool RenderThread::busy() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending || rendering;
+}
+
+void RenderThread::loop()
+{
+    if (attach_context)
+        attach_context();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return pending || stopping; });
+        if (stopping)
+        {
+            // GL objects go while their context is still current
+            hybrid_engine.reset();
+            return;
+        }
+
+        RenderRequest request = pending_request;
+        pending = false;
+        rendering = true;
+        cancel = false;
+        lock.unlock();
+
+        // A cancelled frame stays in the back slot to be overwritten
+        RenderedFrame& frame = frames.back();
+        if (render(request, frame))
+            frames.publish();
+
+        lock.lock();
+        rendering = false;
+    }
+}
+
+bool RenderThread::render(const RenderRequest& request, RenderedFrame& frame)
+{
+    auto start = std::chrono::steady_clock::now();
+    bool rendered = false;
+    EngineType engine = request.engine == EngineType::HYBRID && !attach_context ? EngineType::CPU : request.engine;
+    switch (engine)
+    {
+        case EngineType::HYBRID:
+            if (!hybrid_engine)
+            {
+                hybrid_engine.reset(new HybridEngine(scheduler));
+                hybrid_engine->setCancelFlag(&cancel);
+            }
+            hybrid_engine->setInterior(request.interior);
+            hybrid_engine->cpu().fill = request.fill;
+            hybrid_engine->cpu().focus_x = request.focus_x;
+            hybrid_engine->cpu().focus_y = request.focus_y;
+            rendered = hybrid_engine->render(request.view, frame.buffer);
+            frame.precision = "GPU " + std::to_string(100 * hybrid_engine->lastGpuRows() / std::max(1, request.view.height))
+                + "% + CPU " + CPU_PRECISIONS.at(hybrid_engine->cpu().lastPrecision());
+            break;
+        case EngineType::CPU:
+            cpu_engine.interior = request.interior;
+            cpu_engine.fill = request.fill;
+            cpu_engine.focus_x = request.focus_x;
+            cpu_engine.focus_y = request.focus_y;
+            rendered = cpu_engine.render(request.view, frame.buffer);
+            frame.precision = CPU_PRECISIONS.at(cpu_engine.lastPrecision());
+            break;
+        case EngineType::PERTURBATION:
+            rendered = perturbation_engine.render(request.view, frame.buffer);
+            frame.precision = "perturbation";
+            break;
+        case EngineType::AUTO:
+            auto_engine.interior = request.interior;
+            auto_engine.focus_x = request.focus_x;
+            auto_engine.focus_y = request.focus_y;
+            rendered = auto_engine.render(request.view, frame.buffer);
+            frame.tier = auto_engine.lastTier();
+            frame.precision = PRECISION_TIERS.at(frame.tier);
+            break;
+        default:
+            break;
+    }
+    if (!rendered || cancel)
+        return false;
+
+    frame.request = request;
+    frame.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "auto_engine.h"
+#include "cpu_engine.h"
+#include "hybrid_engine.h"
+#include "perturbation_engine.h"
+#include "triple_buffer.h"
+
+// Everything one frame depends on, copied when it's submitted so the UI can
+// keep changing its own state while the frame renders
+struct RenderRequest
+{
+    View view;
+    EngineType engine = EngineType::CPU;
+    InteriorChecks interior;
+    TileFill fill = TileFill::FULL;
+    // Pixel to render first, as in CpuEngine
+    double focus_x = -1.0, focus_y = -1.0;
+};
+
+struct RenderedFrame
+{
+    RenderRequest request;
+    IterationBuffer buffer;
+    double seconds = 0.0;
+    std::string precision; // number type or tier the engine settled on
+    PrecisionTier tier = PrecisionTier::CPU_DOUBLE; // AUTO only
+};
+
+// Renders CPU-side engines on a thread of their own, so a slow frame never
+// holds up input or drawing. Submitting a request cancels the one in
+// progress; finished frames are published through a triple buffer the UI
+// thread polls once per frame. The GPU engine stays with the UI thread (AUTO
+// plans without it here); HYBRID needs `attach_context` to make a GL context
+// current on this thread, one sharing objects with the UI's, and falls back
+// to the CPU engine without it.
+class RenderThread
+{
+public:
+    explicit RenderThread(std::function<void()> attach_context = nullptr);
+    ~RenderThread();
+
+    // Replaces whatever is queued or rendering with `request`
+    void submit(const RenderRequest& request);
+
+    // UI side: picks up the newest finished frame, returning false if there
+    // isn't one since the last call
+    bool update() { return frames.update(); }
+    const RenderedFrame& frame() const { return frames.front(); }
+
+    // Whether a submitted request hasn't been published yet
+    bool busy() const;
+
+private:
+    void loop();
+    bool render(const RenderRequest& request, RenderedFrame& frame);
+
+    std::shared_ptr<TileScheduler> scheduler;
+    CpuEngine cpu_engine;
+    PerturbationEngine perturbation_engine;
+    AutoEngine auto_engine;
+    std::function<void()> attach_context;
+    std::unique_ptr<HybridEngine> hybrid_engine; // created on the thread, once its context is current
+
+    TripleBuffer<RenderedFrame> frames;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    RenderRequest pending_request;
+    bool pending = false;
+    bool rendering = false;
+    bool stopping = false;
+    std::atomic<bool> cancel{false};
+    std::thread thread;
+};
+
+#endif
@@ -3,6 +3,8 @@
 #include <sstream>
 #include <string>
 
+// Loads a shader and splices in any `#include "path"` lines, resolved relative
+// to the including file, so shaders can share code from shaders/common.
 std::string loadShaderSource(const std::string& filePath)
 {
     std::ifstream shaderFile;
@@ -14,10 +16,23 @@ std::string loadShaderSource(const std::string& filePath)
         return "";
     }
     
+    std::string directory;
+    size_t slash = filePath.find_last_of('/');
+    if (slash != std::string::npos)
+        directory = filePath.substr(0, slash + 1);
+
     std::stringstream shaderStream;
-    shaderStream << shaderFile.rdbuf();
+    std::string line;
+    while (std::getline(shaderFile, line))
+    {
+        size_t open_quote = line.find('"');
+        size_t close_quote = line.rfind('"');
+        if (line.compare(0, 8, "#include") == 0 && open_quote != close_quote)
+            shaderStream << loadShaderSource(directory + line.substr(open_quote + 1, close_quote - open_quote - 1));
+        else
+            shaderStream << line << '\n';
+    }
     shaderFile.close();
     
     return shaderStream.str();
 }
-
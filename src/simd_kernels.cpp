@@ -0,0 +1,492 @@
+#include "simd_kernels.h"
+
+#include <limits>
+#include <utility>
+
+#include "cpu_engine.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEIBNIZ_X86_SIMD 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace
+{
+
+// Scalar bookkeeping behind the vector registers: which pixel each lane is
+// working on, and where the next pixel comes from. Pixels the cardioid test
+// settles never reach a lane.
+template <typename T, int W, unsigned CHECKS>
+struct Lanes
+{
+    alignas(64) T cx[W];
+    alignas(64) T cy[W];
+    alignas(64) T x[W];
+    alignas(64) T y[W];
+    alignas(64) T iteration[W];
+    alignas(64) T saved_x[W];
+    alignas(64) T saved_y[W];
+    alignas(64) T check_at[W];
+    alignas(64) T dx[W];
+    alignas(64) T dy[W];
+    int pixel[W];
+
+    const T* source_x;
+    const T* source_y;
+    int count;
+    int max_iterations;
+    int* iterations;
+    int next = 0;
+
+    Lanes(const T* source_x, const T* source_y, int count, int max_iterations, int* iterations)
+        : source_x(source_x), source_y(source_y), count(count), max_iterations(max_iterations), iterations(iterations)
+    {
+        for (int lane = 0; lane < W; lane++)
+            load(lane);
+    }
+
+    void load(int lane)
+    {
+        if (CHECKS & INTERIOR_CARDIOID)
+        {
+            while (next < count && inMainCardioidOrBulb(source_x[next], source_y[next]))
+                iterations[next++] = max_iterations;
+        }
+
+        x[lane] = y[lane] = T(0);
+        saved_x[lane] = saved_y[lane] = T(0);
+        check_at[lane] = T(1);
+        dx[lane] = T(1);
+        dy[lane] = T(0);
+        if (next < count)
+        {
+            pixel[lane] = next;
+            cx[lane] = source_x[next];
+            cy[lane] = source_y[next];
+            iteration[lane] = T(0);
+            next++;
+        }
+        else
+        {
+            // Idle lanes sit at c = 0, which never escapes, and never reach
+            // the cap either. A NaN saved z and derivative keep the interior
+            // checks from firing on them.
+            pixel[lane] = -1;
+            cx[lane] = cy[lane] = T(0);
+            iteration[lane] = -std::numeric_limits<T>::infinity();
+            saved_x[lane] = saved_y[lane] = std::numeric_limits<T>::quiet_NaN();
+            dx[lane] = dy[lane] = std::numeric_limits<T>::quiet_NaN();
+        }
+    }
+
+    bool anyActive() const
+    {
+        for (int lane = 0; lane < W; lane++)
+            if (pixel[lane] >= 0)
+                return true;
+        return false;
+    }
+
+    // Writes results for the finished lanes and refills them. Lanes that
+    // finished without escaping count as interior. Returns false once every
+    // lane is idle.
+    bool retire(unsigned done, unsigned escaped)
+    {
+        bool active = false;
+        for (int lane = 0; lane < W; lane++)
+        {
+            if (done >> lane & 1)
+            {
+                if (pixel[lane] >= 0)
+                    iterations[pixel[lane]] = (escaped >> lane & 1) ? (int)iteration[lane] - 1 : max_iterations;
+                load(lane);
+            }
+            active |= pixel[lane] >= 0;
+        }
+        return active;
+    }
+};
+
+template <unsigned CHECKS, typename T>
+void spanScalar(const T* cx, const T* cy, int count, int max_iterations, int* iterations)
+{
+    for (int i = 0; i < count; i++)
+        iterations[i] = iterateMandelbrotChecked<CHECKS>(cx[i], cy[i], max_iterations);
+}
+
+#ifdef LEIBNIZ_X86_SIMD
+
+template <unsigned CHECKS>
+TARGET_AVX2 void spanAvx2Double(const double* source_x, const double* source_y, int count, int max_iterations, int* iterations)
+{
+    Lanes<double, 4, CHECKS> lanes(source_x, source_y, count, max_iterations, iterations);
+    if (!lanes.anyActive())
+        return; // empty span, or the cardioid test settled all of it
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d cap = _mm256_set1_pd((double)max_iterations);
+    const __m256d epsilon = _mm256_set1_pd(INTERIOR_DERIVATIVE_EPSILON);
+    __m256d cx = _mm256_load_pd(lanes.cx), cy = _mm256_load_pd(lanes.cy);
+    __m256d x = _mm256_load_pd(lanes.x), y = _mm256_load_pd(lanes.y);
+    __m256d iteration = _mm256_load_pd(lanes.iteration);
+    __m256d saved_x = _mm256_load_pd(lanes.saved_x), saved_y = _mm256_load_pd(lanes.saved_y);
+    __m256d check_at = _mm256_load_pd(lanes.check_at);
+    __m256d dx = _mm256_load_pd(lanes.dx), dy = _mm256_load_pd(lanes.dy);
+
+    for (;;)
+    {
+        __m256d xx = _mm256_mul_pd(x, x), yy = _mm256_mul_pd(y, y), xy = _mm256_mul_pd(x, y);
+        x = _mm256_add_pd(_mm256_sub_pd(xx, yy), cx);
+        y = _mm256_add_pd(_mm256_add_pd(xy, xy), cy);
+        iteration = _mm256_add_pd(iteration, one);
+
+        __m256d norm = _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y));
+        unsigned escaped = _mm256_movemask_pd(_mm256_cmp_pd(norm, four, _CMP_GT_OQ));
+        unsigned done = escaped | _mm256_movemask_pd(_mm256_cmp_pd(iteration, cap, _CMP_GE_OQ));
+        if (CHECKS & INTERIOR_PERIODICITY)
+        {
+            __m256d same = _mm256_and_pd(_mm256_cmp_pd(x, saved_x, _CMP_EQ_OQ), _mm256_cmp_pd(y, saved_y, _CMP_EQ_OQ));
+            done |= _mm256_movemask_pd(same);
+            __m256d save = _mm256_cmp_pd(iteration, check_at, _CMP_EQ_OQ);
+            saved_x = _mm256_blendv_pd(saved_x, x, save);
+            saved_y = _mm256_blendv_pd(saved_y, y, save);
+            check_at = _mm256_blendv_pd(check_at, _mm256_add_pd(check_at, check_at), save);
+        }
+        if (CHECKS & INTERIOR_DERIVATIVE)
+        {
+            __m256d next_dx = _mm256_mul_pd(two, _mm256_sub_pd(_mm256_mul_pd(x, dx), _mm256_mul_pd(y, dy)));
+            dy = _mm256_mul_pd(two, _mm256_add_pd(_mm256_mul_pd(x, dy), _mm256_mul_pd(y, dx)));
+            dx = next_dx;
+            __m256d derivative = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+            done |= _mm256_movemask_pd(_mm256_cmp_pd(derivative, epsilon, _CMP_LT_OQ));
+        }
+        if (!done)
+            continue;
+
+        _mm256_store_pd(lanes.x, x);
+        _mm256_store_pd(lanes.y, y);
+        _mm256_store_pd(lanes.iteration, iteration);
+        _mm256_store_pd(lanes.saved_x, saved_x);
+        _mm256_store_pd(lanes.saved_y, saved_y);
+        _mm256_store_pd(lanes.check_at, check_at);
+        _mm256_store_pd(lanes.dx, dx);
+        _mm256_store_pd(lanes.dy, dy);
+        if (!lanes.retire(done, escaped))
+            return;
+        cx = _mm256_load_pd(lanes.cx);
+        cy = _mm256_load_pd(lanes.cy);
+        x = _mm256_load_pd(lanes.x);
+        y = _mm256_load_pd(lanes.y);
+        iteration = _mm256_load_pd(lanes.iteration);
+        saved_x = _mm256_load_pd(lanes.saved_x);
+        saved_y = _mm256_load_pd(lanes.saved_y);
+        check_at = _mm256_load_pd(lanes.check_at);
+        dx = _mm256_load_pd(lanes.dx);
+        dy = _mm256_load_pd(lanes.dy);
+    }
+}
+
+template <unsigned CHECKS>
+TARGET_AVX2 void spanAvx2Float(const float* source_x, const float* source_y, int count, int max_iterations, int* iterations)
+{
+    Lanes<float, 8, CHECKS> lanes(source_x, source_y, count, max_iterations, iterations);
+    if (!lanes.anyActive())
+        return; // empty span, or the cardioid test settled all of it
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 cap = _mm256_set1_ps((float)max_iterations);
+    const __m256 epsilon = _mm256_set1_ps((float)INTERIOR_DERIVATIVE_EPSILON);
+    __m256 cx = _mm256_load_ps(lanes.cx), cy = _mm256_load_ps(lanes.cy);
+    __m256 x = _mm256_load_ps(lanes.x), y = _mm256_load_ps(lanes.y);
+    __m256 iteration = _mm256_load_ps(lanes.iteration);
+    __m256 saved_x = _mm256_load_ps(lanes.saved_x), saved_y = _mm256_load_ps(lanes.saved_y);
+    __m256 check_at = _mm256_load_ps(lanes.check_at);
+    __m256 dx = _mm256_load_ps(lanes.dx), dy = _mm256_load_ps(lanes.dy);
+
+    for (;;)
+    {
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), xy = _mm256_mul_ps(x, y);
+        x = _mm256_add_ps(_mm256_sub_ps(xx, yy), cx);
+        y = _mm256_add_ps(_mm256_add_ps(xy, xy), cy);
+        iteration = _mm256_add_ps(iteration, one);
+
+        __m256 norm = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+        unsigned escaped = _mm256_movemask_ps(_mm256_cmp_ps(norm, four, _CMP_GT_OQ));
+        unsigned done = escaped | _mm256_movemask_ps(_mm256_cmp_ps(iteration, cap, _CMP_GE_OQ));
+        if (CHECKS & INTERIOR_PERIODICITY)
+        {
+            __m256 same = _mm256_and_ps(_mm256_cmp_ps(x, saved_x, _CMP_EQ_OQ), _mm256_cmp_ps(y, saved_y, _CMP_EQ_OQ));
+            done |= _mm256_movemask_ps(same);
+            __m256 save = _mm256_cmp_ps(iteration, check_at, _CMP_EQ_OQ);
+            saved_x = _mm256_blendv_ps(saved_x, x, save);
+            saved_y = _mm256_blendv_ps(saved_y, y, save);
+            check_at = _mm256_blendv_ps(check_at, _mm256_add_ps(check_at, check_at), save);
+        }
+        if (CHECKS & INTERIOR_DERIVATIVE)
+        {
+            __m256 next_dx = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(x, dx), _mm256_mul_ps(y, dy)));
+            dy = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(x, dy), _mm256_mul_ps(y, dx)));
+            dx = next_dx;
+            __m256 derivative = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            done |= _mm256_movemask_ps(_mm256_cmp_ps(derivative, epsilon, _CMP_LT_OQ));
+        }
+        if (!done)
+            continue;
+
+        _mm256_store_ps(lanes.x, x);
+        _mm256_store_ps(lanes.y, y);
+        _mm256_store_ps(lanes.iteration, iteration);
+        _mm256_store_ps(lanes.saved_x, saved_x);
+        _mm256_store_ps(lanes.saved_y, saved_y);
+        _mm256_store_ps(lanes.check_at, check_at);
+        _mm256_store_ps(lanes.dx, dx);
+        _mm256_store_ps(lanes.dy, dy);
+        if (!lanes.retire(done, escaped))
+            return;
+        cx = _mm256_load_ps(lanes.cx);
+        cy = _mm256_load_ps(lanes.cy);
+        x = _mm256_load_ps(lanes.x);
+        y = _mm256_load_ps(lanes.y);
+        iteration = _mm256_load_ps(lanes.iteration);
+        saved_x = _mm256_load_ps(lanes.saved_x);
+        saved_y = _mm256_load_ps(lanes.saved_y);
+        check_at = _mm256_load_ps(lanes.check_at);
+        dx = _mm256_load_ps(lanes.dx);
+        dy = _mm256_load_ps(lanes.dy);
+    }
+}
+
+template <unsigned CHECKS>
+TARGET_AVX512 void spanAvx512Double(const double* source_x, const double* source_y, int count, int max_iterations, int* iterations)
+{
+    Lanes<double, 8, CHECKS> lanes(source_x, source_y, count, max_iterations, iterations);
+    if (!lanes.anyActive())
+        return; // empty span, or the cardioid test settled all of it
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512d cap = _mm512_set1_pd((double)max_iterations);
+    const __m512d epsilon = _mm512_set1_pd(INTERIOR_DERIVATIVE_EPSILON);
+    __m512d cx = _mm512_load_pd(lanes.cx), cy = _mm512_load_pd(lanes.cy);
+    __m512d x = _mm512_load_pd(lanes.x), y = _mm512_load_pd(lanes.y);
+    __m512d iteration = _mm512_load_pd(lanes.iteration);
+    __m512d saved_x = _mm512_load_pd(lanes.saved_x), saved_y = _mm512_load_pd(lanes.saved_y);
+    __m512d check_at = _mm512_load_pd(lanes.check_at);
+    __m512d dx = _mm512_load_pd(lanes.dx), dy = _mm512_load_pd(lanes.dy);
+
+    for (;;)
+    {
+        __m512d xx = _mm512_mul_pd(x, x), yy = _mm512_mul_pd(y, y), xy = _mm512_mul_pd(x, y);
+        x = _mm512_add_pd(_mm512_sub_pd(xx, yy), cx);
+        y = _mm512_add_pd(_mm512_add_pd(xy, xy), cy);
+        iteration = _mm512_add_pd(iteration, one);
+
+        __m512d norm = _mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y));
+        unsigned escaped = _mm512_cmp_pd_mask(norm, four, _CMP_GT_OQ);
+        unsigned done = escaped | _mm512_cmp_pd_mask(iteration, cap, _CMP_GE_OQ);
+        if (CHECKS & INTERIOR_PERIODICITY)
+        {
+            done |= _mm512_cmp_pd_mask(x, saved_x, _CMP_EQ_OQ) & _mm512_cmp_pd_mask(y, saved_y, _CMP_EQ_OQ);
+            __mmask8 save = _mm512_cmp_pd_mask(iteration, check_at, _CMP_EQ_OQ);
+            saved_x = _mm512_mask_blend_pd(save, saved_x, x);
+            saved_y = _mm512_mask_blend_pd(save, saved_y, y);
+            check_at = _mm512_mask_blend_pd(save, check_at, _mm512_add_pd(check_at, check_at));
+        }
+        if (CHECKS & INTERIOR_DERIVATIVE)
+        {
+            __m512d next_dx = _mm512_mul_pd(two, _mm512_sub_pd(_mm512_mul_pd(x, dx), _mm512_mul_pd(y, dy)));
+            dy = _mm512_mul_pd(two, _mm512_add_pd(_mm512_mul_pd(x, dy), _mm512_mul_pd(y, dx)));
+            dx = next_dx;
+            __m512d derivative = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+            done |= _mm512_cmp_pd_mask(derivative, epsilon, _CMP_LT_OQ);
+        }
+        if (!done)
+            continue;
+
+        _mm512_store_pd(lanes.x, x);
+        _mm512_store_pd(lanes.y, y);
+        _mm512_store_pd(lanes.iteration, iteration);
+        _mm512_store_pd(lanes.saved_x, saved_x);
+        _mm512_store_pd(lanes.saved_y, saved_y);
+        _mm512_store_pd(lanes.check_at, check_at);
+        _mm512_store_pd(lanes.dx, dx);
+        _mm512_store_pd(lanes.dy, dy);
+        if (!lanes.retire(done, escaped))
+            return;
+        cx = _mm512_load_pd(lanes.cx);
+        cy = _mm512_load_pd(lanes.cy);
+        x = _mm512_load_pd(lanes.x);
+        y = _mm512_load_pd(lanes.y);
+        iteration = _mm512_load_pd(lanes.iteration);
+        saved_x = _mm512_load_pd(lanes.saved_x);
+        saved_y = _mm512_load_pd(lanes.saved_y);
+        check_at = _mm512_load_pd(lanes.check_at);
+        dx = _mm512_load_pd(lanes.dx);
+        dy = _mm512_load_pd(lanes.dy);
+    }
+}
+
+template <unsigned CHECKS>
+TARGET_AVX512 void spanAvx512Float(const float* source_x, const float* source_y, int count, int max_iterations, int* iterations)
+{
+    Lanes<float, 16, CHECKS> lanes(source_x, source_y, count, max_iterations, iterations);
+    if (!lanes.anyActive())
+        return; // empty span, or the cardioid test settled all of it
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 two = _mm512_set1_ps(2.0f);
+    const __m512 four = _mm512_set1_ps(4.0f);
+    const __m512 cap = _mm512_set1_ps((float)max_iterations);
+    const __m512 epsilon = _mm512_set1_ps((float)INTERIOR_DERIVATIVE_EPSILON);
+    __m512 cx = _mm512_load_ps(lanes.cx), cy = _mm512_load_ps(lanes.cy);
+    __m512 x = _mm512_load_ps(lanes.x), y = _mm512_load_ps(lanes.y);
+    __m512 iteration = _mm512_load_ps(lanes.iteration);
+    __m512 saved_x = _mm512_load_ps(lanes.saved_x), saved_y = _mm512_load_ps(lanes.saved_y);
+    __m512 check_at = _mm512_load_ps(lanes.check_at);
+    __m512 dx = _mm512_load_ps(lanes.dx), dy = _mm512_load_ps(lanes.dy);
+
+    for (;;)
+    {
+        __m512 xx = _mm512_mul_ps(x, x), yy = _mm512_mul_ps(y, y), xy = _mm512_mul_ps(x, y);
+        x = _mm512_add_ps(_mm512_sub_ps(xx, yy), cx);
+        y = _mm512_add_ps(_mm512_add_ps(xy, xy), cy);
+        iteration = _mm512_add_ps(iteration, one);
+
+        __m512 norm = _mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y));
+        unsigned escaped = _mm512_cmp_ps_mask(norm, four, _CMP_GT_OQ);
+        unsigned done = escaped | _mm512_cmp_ps_mask(iteration, cap, _CMP_GE_OQ);
+        if (CHECKS & INTERIOR_PERIODICITY)
+        {
+            done |= _mm512_cmp_ps_mask(x, saved_x, _CMP_EQ_OQ) & _mm512_cmp_ps_mask(y, saved_y, _CMP_EQ_OQ);
+            __mmask16 save = _mm512_cmp_ps_mask(iteration, check_at, _CMP_EQ_OQ);
+            saved_x = _mm512_mask_blend_ps(save, saved_x, x);
+            saved_y = _mm512_mask_blend_ps(save, saved_y, y);
+            check_at = _mm512_mask_blend_ps(save, check_at, _mm512_add_ps(check_at, check_at));
+        }
+        if (CHECKS & INTERIOR_DERIVATIVE)
+        {
+            __m512 next_dx = _mm512_mul_ps(two, _mm512_sub_ps(_mm512_mul_ps(x, dx), _mm512_mul_ps(y, dy)));
+            dy = _mm512_mul_ps(two, _mm512_add_ps(_mm512_mul_ps(x, dy), _mm512_mul_ps(y, dx)));
+            dx = next_dx;
+            __m512 derivative = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+            done |= _mm512_cmp_ps_mask(derivative, epsilon, _CMP_LT_OQ);
+        }
+        if (!done)
+            continue;
+
+        _mm512_store_ps(lanes.x, x);
+        _mm512_store_ps(lanes.y, y);
+        _mm512_store_ps(lanes.iteration, iteration);
+        _mm512_store_ps(lanes.saved_x, saved_x);
+        _mm512_store_ps(lanes.saved_y, saved_y);
+        _mm512_store_ps(lanes.check_at, check_at);
+        _mm512_store_ps(lanes.dx, dx);
+        _mm512_store_ps(lanes.dy, dy);
+        if (!lanes.retire(done, escaped))
+            return;
+        cx = _mm512_load_ps(lanes.cx);
+        cy = _mm512_load_ps(lanes.cy);
+        x = _mm512_load_ps(lanes.x);
+        y = _mm512_load_ps(lanes.y);
+        iteration = _mm512_load_ps(lanes.iteration);
+        saved_x = _mm512_load_ps(lanes.saved_x);
+        saved_y = _mm512_load_ps(lanes.saved_y);
+        check_at = _mm512_load_ps(lanes.check_at);
+        dx = _mm512_load_ps(lanes.dx);
+        dy = _mm512_load_ps(lanes.dy);
+    }
+}
+
+#endif
+
+}
+
+SimdLevel detectSimdLevel()
+{
+#ifdef LEIBNIZ_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        default:
+            return "Scalar";
+    }
+}
+
+namespace
+{
+
+template <unsigned CHECKS>
+DoubleSpanKernel doubleSpanKernelWith(SimdLevel level)
+{
+    switch (level)
+    {
+#ifdef LEIBNIZ_X86_SIMD
+        case SimdLevel::AVX2:
+            return spanAvx2Double<CHECKS>;
+        case SimdLevel::AVX512:
+            return spanAvx512Double<CHECKS>;
+#endif
+        default:
+            return spanScalar<CHECKS, double>;
+    }
+}
+
+template <unsigned CHECKS>
+FloatSpanKernel floatSpanKernelWith(SimdLevel level)
+{
+    switch (level)
+    {
+#ifdef LEIBNIZ_X86_SIMD
+        case SimdLevel::AVX2:
+            return spanAvx2Float<CHECKS>;
+        case SimdLevel::AVX512:
+            return spanAvx512Float<CHECKS>;
+#endif
+        default:
+            return spanScalar<CHECKS, float>;
+    }
+}
+
+// One instantiation per combination of checks, indexed by InteriorChecks::mask()
+template <unsigned... CHECKS>
+DoubleSpanKernel pickDoubleSpanKernel(SimdLevel level, unsigned mask, std::integer_sequence<unsigned, CHECKS...>)
+{
+    const DoubleSpanKernel kernels[] = { doubleSpanKernelWith<CHECKS>(level)... };
+    return kernels[mask];
+}
+
+template <unsigned... CHECKS>
+FloatSpanKernel pickFloatSpanKernel(SimdLevel level, unsigned mask, std::integer_sequence<unsigned, CHECKS...>)
+{
+    const FloatSpanKernel kernels[] = { floatSpanKernelWith<CHECKS>(level)... };
+    return kernels[mask];
+}
+
+}
+
+DoubleSpanKernel doubleSpanKernel(SimdLevel level, const InteriorChecks& checks)
+{
+    return pickDoubleSpanKernel(level, checks.mask(), std::make_integer_sequence<unsigned, INTERIOR_CHECK_COMBINATIONS>());
+}
+
+FloatSpanKernel floatSpanKernel(SimdLevel level, const InteriorChecks& checks)
+{
+    return pickFloatSpanKernel(level, checks.mask(), std::make_integer_sequence<unsigned, INTERIOR_CHECK_COMBINATIONS>());
+}
@@ -0,0 +1,38 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+// Escape-time kernels over a span of pixels. Each kernel keeps one pixel per
+// vector lane; when a lane escapes or hits the cap its result is written and
+// the lane is refilled with the next pixel of the span, so divergent
+// iteration counts don't leave lanes idle.
+//
+// The best kernel for the running CPU is picked once through CPUID, so the
+// same binary runs everywhere. Results match iterateMandelbrot() in the same
+// precision exactly; no FMA contraction is allowed in the vector code. Each
+// combination of interior checks gets its own instantiation, so disabled
+// checks cost nothing in the loop.
+
+#include "interior_checks.h"
+
+enum class SimdLevel
+{
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+typedef void (*DoubleSpanKernel)(const double* cx, const double* cy, int count, int max_iterations, int* iterations);
+typedef void (*FloatSpanKernel)(const float* cx, const float* cy, int count, int max_iterations, int* iterations);
+
+// The float kernels count iterations in float lanes, which are only exact up
+// to 2^24; callers use the double kernels above this cap
+const int FLOAT_KERNEL_MAX_ITERATIONS = 1 << 24;
+
+SimdLevel detectSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// With checks enabled, results match iterateMandelbrotChecked() instead
+DoubleSpanKernel doubleSpanKernel(SimdLevel level, const InteriorChecks& checks = InteriorChecks());
+FloatSpanKernel floatSpanKernel(SimdLevel level, const InteriorChecks& checks = InteriorChecks());
+
+#endif
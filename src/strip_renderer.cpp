@@ -0,0 +1,351 @@
+#include "strip_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Writes strips on its own thread. At most one strip waits or is being
+// written while the caller fills the next, so two strips are all there are.
+class StripWriter
+{
+public:
+    explicit StripWriter(ImageWriter& writer)
+        : writer(writer), thread(&StripWriter::writeLoop, this)
+    {
+    }
+
+    ~StripWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    // Waits for the previous strip to be written, then takes `rgb`, leaving
+    // the caller that strip's buffer to reuse. False once a write has failed.
+    bool write(std::vector<uint8_t>& rgb, int rows)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !queued; });
+        if (!ok)
+            return false;
+        std::swap(rgb, strip);
+        strip_rows = rows;
+        queued = true;
+        changed.notify_all();
+        return true;
+    }
+
+    // Waits for the last strip, then finishes the file
+    bool finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !queued; });
+        return writer.finish() && ok;
+    }
+
+private:
+    void writeLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            changed.wait(lock, [this] { return queued || stopping; });
+            if (!queued)
+                return;
+            // The strip stays queued while it's written, so write() can't
+            // touch it
+            lock.unlock();
+            bool written = writer.writeRows(strip.data(), strip_rows);
+            lock.lock();
+            ok = ok && written;
+            queued = false;
+            changed.notify_all();
+        }
+    }
+
+    ImageWriter& writer;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<uint8_t> strip;
+    int strip_rows = 0;
+    bool queued = false;
+    bool stopping = false;
+    bool ok = true;
+    std::thread thread;
+};
+
+// Image rows from `top_row` down, `rows` of them, each the average of a
+// `samples` x `samples` block of `band`, whose row 0 is supersampled view row
+// `band_first_row`. Same grayscale as grayscaleRows().
+void downsampleRows(const IterationBuffer& band, int band_first_row, int samples, int max_iterations, int top_row,
+                    int rows, int width, std::vector<uint8_t>& rgb)
+{
+    rgb.resize((size_t)width * 3 * rows);
+    uint8_t* out = rgb.data();
+    float scale = 255.0f / ((float)max_iterations * samples * samples);
+    for (int row = 0; row < rows; row++)
+    {
+        int band_row = (top_row - row) * samples - band_first_row;
+        for (int x = 0; x < width; x++)
+        {
+            int64_t sum = 0;
+            for (int j = 0; j < samples; j++)
+                for (int i = 0; i < samples; i++)
+                    sum += band.at(x * samples + i, band_row + j);
+            uint8_t value = (uint8_t)(scale * sum + 0.5f);
+            *out++ = value;
+            *out++ = value;
+            *out++ = value;
+        }
+    }
+}
+
+// Adaptive sampling state. Extra samples sit in the cells of a grid over the
+// pixel, jittered within each cell by a hash of pixel and sample, so a pixel
+// gets the same samples however the image is cut into strips.
+class EdgeSampler
+{
+public:
+    EdgeSampler(const View& view, const StripRenderOptions& options)
+        : view(view), extra(std::max(0, options.adaptive_samples - 1)), edge_levels(options.edge_levels)
+    {
+        grid = 1;
+        while (grid * grid < extra)
+            grid++;
+        // Cells in reversed Morton order: consecutive samples land in
+        // different quadrants, then different quadrants of those
+        int bits = 0;
+        while ((1 << bits) < grid)
+            bits++;
+        std::vector<std::pair<uint32_t, int>> keyed;
+        for (int cell = 0; cell < grid * grid; cell++)
+        {
+            uint32_t morton = 0;
+            for (int bit = 0; bit < bits; bit++)
+                morton |= (((cell % grid) >> bit & 1) << (2 * bit)) | (((cell / grid) >> bit & 1) << (2 * bit + 1));
+            uint32_t reversed = 0;
+            for (int bit = 0; bit < 2 * bits; bit++)
+                reversed |= (morton >> bit & 1) << (2 * bits - 1 - bit);
+            keyed.push_back({ reversed, cell });
+        }
+        std::sort(keyed.begin(), keyed.end());
+        for (const auto& pair : keyed)
+            cells.push_back(pair.second);
+    }
+
+    // Rows from `top_row` down, `rows` of them, one sample per pixel from
+    // `band` (view rows from `band_first_row`, one more above and below where
+    // the view has them) and more at edges
+    bool sampleRows(CpuEngine& engine, const IterationBuffer& band, int band_first_row, int top_row, int rows,
+                    std::vector<uint8_t>& rgb, StripRenderStats& stats)
+    {
+        const int FIRST_BATCH = 4;
+        grayscaleRows(band, view.max_iterations, top_row - band_first_row, rows, rgb);
+        stats.samples += (size_t)view.width * rows;
+        if (extra == 0)
+            return true;
+
+        edges.clear();
+        int band_last_row = band_first_row + band.height - 1;
+        for (int row = 0; row < rows; row++)
+        {
+            int y = top_row - row;
+            for (int x = 0; x < view.width; x++)
+                if (isEdge(band, band_first_row, band_last_row, x, y))
+                    edges.push_back({ x, y, band.at(x, y - band_first_row), 1, band.at(x, y - band_first_row),
+                                      band.at(x, y - band_first_row) });
+        }
+
+        // A first batch for every edge, the rest only where it disagrees
+        int first = std::min(extra, FIRST_BATCH);
+        if (!sampleBatch(engine, 0, first, stats))
+            return false;
+        if (extra > first)
+        {
+            std::vector<EdgePixel> settled;
+            std::vector<EdgePixel> unsettled;
+            for (const EdgePixel& edge : edges)
+                (levels(edge.high - edge.low) > edge_levels ? unsettled : settled).push_back(edge);
+            edges.swap(unsettled);
+            if (!sampleBatch(engine, first, extra, stats))
+                return false;
+            edges.insert(edges.end(), settled.begin(), settled.end());
+        }
+
+        for (const EdgePixel& edge : edges)
+        {
+            uint8_t value = (uint8_t)(255.0f * edge.sum / ((float)view.max_iterations * edge.count) + 0.5f);
+            uint8_t* out = &rgb[((size_t)(top_row - edge.y) * view.width + edge.x) * 3];
+            out[0] = out[1] = out[2] = value;
+        }
+        return true;
+    }
+
+private:
+    struct EdgePixel
+    {
+        int x, y;
+        int64_t sum; // of the samples' counts
+        int count;
+        int low, high;
+    };
+
+    float levels(int count_difference) const { return 255.0f * count_difference / view.max_iterations; }
+
+    bool isEdge(const IterationBuffer& band, int band_first_row, int band_last_row, int x, int y) const
+    {
+        int center = band.at(x, y - band_first_row);
+        for (int ny = std::max(y - 1, band_first_row); ny <= std::min(y + 1, band_last_row); ny++)
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, view.width - 1); nx++)
+                if (levels(std::abs(band.at(nx, ny - band_first_row) - center)) > edge_levels)
+                    return true;
+        return false;
+    }
+
+    // Samples [first, last) of every pixel in `edges`
+    bool sampleBatch(CpuEngine& engine, int first, int last, StripRenderStats& stats)
+    {
+        xs.clear();
+        ys.clear();
+        for (const EdgePixel& edge : edges)
+        {
+            for (int k = first; k < last; k++)
+            {
+                int cell = cells[k];
+                xs.push_back(edge.x + (cell % grid + jitter(edge.x, edge.y, k, 0)) / grid);
+                ys.push_back(edge.y + (cell / grid + jitter(edge.x, edge.y, k, 1)) / grid);
+            }
+        }
+        if (xs.empty())
+            return true;
+        if (!engine.renderPoints(view, xs, ys, counts))
+            return false;
+
+        size_t next = 0;
+        for (EdgePixel& edge : edges)
+        {
+            for (int k = first; k < last; k++, next++)
+            {
+                edge.sum += counts[next];
+                edge.low = std::min(edge.low, counts[next]);
+                edge.high = std::max(edge.high, counts[next]);
+            }
+            edge.count += last - first;
+        }
+        if (first == 0)
+            stats.edge_pixels += edges.size();
+        stats.samples += xs.size();
+        return true;
+    }
+
+    // In [0, 1); splitmix64's finalizer over the sample's identity
+    static double jitter(int x, int y, int k, int axis)
+    {
+        uint64_t z = ((uint64_t)(uint32_t)x << 32 | (uint32_t)y) ^ ((uint64_t)(k * 2 + axis) * 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        z ^= z >> 31;
+        return (z >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    const View& view;
+    int extra; // samples past the first, at most
+    int edge_levels;
+    int grid;
+    std::vector<int> cells;
+    std::vector<EdgePixel> edges;
+    std::vector<double> xs, ys;
+    std::vector<int> counts;
+};
+
+}
+
+bool renderStrips(const View& view, ImageWriter& writer, const StripRenderOptions& options, StripRenderStats* stats,
+                  std::shared_ptr<TileScheduler> scheduler)
+{
+    bool adaptive = options.adaptive_samples > 1;
+    int samples = adaptive ? 1 : std::max(1, options.supersample);
+    View sampled = view;
+    sampled.width = view.width * samples;
+    sampled.height = view.height * samples;
+
+    int strip_rows = options.strip_rows;
+    if (strip_rows <= 0)
+    {
+        size_t row_bytes = (size_t)sampled.width * samples * sizeof(int) + 2 * (size_t)view.width * 3;
+        strip_rows = (int)std::max<size_t>(1, options.strip_bytes / row_bytes);
+    }
+    strip_rows = std::min(strip_rows, view.height);
+
+    CpuEngine engine(scheduler);
+    engine.fill = options.fill;
+    engine.interior = options.interior;
+
+    StripRenderStats local_stats;
+    StripRenderStats& result = stats ? *stats : local_stats;
+    result = StripRenderStats();
+    result.strip_rows = strip_rows;
+
+    IterationBuffer band;
+    std::vector<uint8_t> rgb;
+    EdgeSampler sampler(view, options);
+    bool ok = true;
+    {
+        StripWriter strip_writer(writer);
+        // Images run top down, views bottom up
+        for (int top = view.height - 1; top >= 0 && ok; top -= strip_rows)
+        {
+            int rows = std::min(strip_rows, top + 1);
+            int bottom = top - rows + 1;
+
+            auto start = std::chrono::steady_clock::now();
+            if (adaptive)
+            {
+                // A row either side for the edge test
+                int band_bottom = std::max(0, bottom - 1);
+                int band_top = std::min(view.height - 1, top + 1);
+                ok = engine.renderBand(view, band, band_bottom, band_top - band_bottom + 1)
+                    && sampler.sampleRows(engine, band, band_bottom, top, rows, rgb, result);
+            }
+            else
+            {
+                ok = engine.renderBand(sampled, band, bottom * samples, rows * samples);
+                if (ok && samples == 1)
+                    grayscaleRows(band, view.max_iterations, rows - 1, rows, rgb);
+                else if (ok)
+                    downsampleRows(band, bottom * samples, samples, view.max_iterations, top, rows, view.width, rgb);
+            }
+            if (!ok)
+                break;
+            result.render_seconds += secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            ok = strip_writer.write(rgb, rows);
+            result.write_wait_seconds += secondsSince(start);
+            result.strips++;
+            result.peak_bytes = std::max(result.peak_bytes,
+                                         band.iterations.size() * sizeof(int) + 2 * (size_t)view.width * 3 * strip_rows);
+        }
+        auto start = std::chrono::steady_clock::now();
+        ok = strip_writer.finish() && ok;
+        result.write_wait_seconds += secondsSince(start);
+    }
+    return ok;
+}
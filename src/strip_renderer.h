@@ -0,0 +1,48 @@
+#ifndef STRIP_RENDERER_H
+#define STRIP_RENDERER_H
+
+#include <cstddef>
+#include <memory>
+
+#include "cpu_engine.h"
+#include "image_writer.h"
+#include "tile_scheduler.h"
+#include "view.h"
+
+struct StripRenderOptions
+{
+    int strip_rows = 0;            // image rows per strip; 0 sizes strips to `strip_bytes`
+    size_t strip_bytes = 64 << 20; // counts plus RGB copies, when sizing automatically
+    int supersample = 1;           // samples per pixel along each axis, averaged
+    // Instead of supersampling every pixel, up to this many jittered samples
+    // for pixels whose gray level differs from a neighbour's by more than
+    // `edge_levels`; 0 or 1 for none
+    int adaptive_samples = 0;
+    int edge_levels = 2;
+    TileFill fill = TileFill::FULL;
+    InteriorChecks interior;
+};
+
+struct StripRenderStats
+{
+    int strips = 0;
+    int strip_rows = 0;
+    size_t peak_bytes = 0;      // iteration band plus the two RGB strips
+    double render_seconds = 0.0;
+    double write_wait_seconds = 0.0; // rendering stalled behind the writer
+    size_t edge_pixels = 0;      // adaptive: pixels given more samples
+    size_t samples = 0;          // samples taken in all, one per pixel and the extra ones
+};
+
+// Renders `view` top to bottom in horizontal strips on the CPU engine and
+// streams each one to `writer` as it finishes, so posters far bigger than
+// memory come out with a few strips' worth of RAM. Each strip is rendered at
+// `supersample` times the resolution and box-filtered down before it's
+// written, or, adaptively, rendered at one sample per pixel with more samples
+// only where the strip has edges. A thread of its own writes one strip while
+// the tile pool renders the next. Calls writer.finish(); false if a strip
+// couldn't be rendered or written.
+bool renderStrips(const View& view, ImageWriter& writer, const StripRenderOptions& options,
+                  StripRenderStats* stats = nullptr, std::shared_ptr<TileScheduler> scheduler = nullptr);
+
+#endif
@@ -0,0 +1,133 @@
+#include "tile_scheduler.h"
+
+#include <algorithm>
+
+TileScheduler::TileScheduler(int threads)
+    : remaining(0)
+{
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    for (int i = 0; i < threads; i++)
+        queues.emplace_back(new WorkerQueue());
+    for (int i = 1; i < threads; i++)
+        this->threads.emplace_back(&TileScheduler::workerLoop, this, i);
+}
+
+TileScheduler::~TileScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void TileScheduler::run(int width, int height, int tile_size, double focus_x, double focus_y, const TileWork& work)
+{
+    tile_size = std::max(1, tile_size);
+    std::vector<Tile> tiles;
+    for (int y = 0; y < height; y += tile_size)
+        for (int x = 0; x < width; x += tile_size)
+            tiles.push_back({ x, y, std::min(tile_size, width - x), std::min(tile_size, height - y) });
+
+    auto distance = [focus_x, focus_y](const Tile& tile)
+    {
+        double dx = tile.x + tile.width * 0.5 - focus_x;
+        double dy = tile.y + tile.height * 0.5 - focus_y;
+        return dx * dx + dy * dy;
+    };
+    std::sort(tiles.begin(), tiles.end(), [&distance](const Tile& a, const Tile& b) { return distance(a) < distance(b); });
+
+    run(tiles, work);
+}
+
+void TileScheduler::run(const std::vector<Tile>& tiles, const TileWork& work)
+{
+    if (tiles.empty())
+        return;
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+
+    // Deal round robin so every worker starts on tiles near the focus
+    for (size_t i = 0; i < tiles.size(); i++)
+        queues[i % queues.size()]->tiles.push_back(tiles[i]);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_work = &work;
+        remaining.store((int)tiles.size());
+        busy_workers = (int)threads.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    drain(0);
+
+    // Workers may still be finishing their last tile
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy_workers == 0; });
+    current_work = nullptr;
+}
+
+void TileScheduler::workerLoop(int worker)
+{
+    unsigned seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        drain(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy_workers == 0)
+            finished.notify_all();
+    }
+}
+
+void TileScheduler::drain(int worker)
+{
+    Tile tile;
+    while (remaining.load(std::memory_order_acquire) > 0 && takeTile(worker, tile))
+    {
+        (*current_work)(tile, worker);
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+bool TileScheduler::takeTile(int worker, Tile& tile)
+{
+    // Own queue first, nearest tile first
+    {
+        WorkerQueue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tiles.empty())
+        {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // Then steal the farthest tile of the next worker that has any
+    int count = (int)queues.size();
+    for (int offset = 1; offset < count; offset++)
+    {
+        WorkerQueue& victim = *queues[(worker + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tiles.empty())
+        {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Tile
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Splits frames into tiles and runs them on a persistent pool. Each worker
+// owns a deque of tiles; workers that run dry steal from the far end of
+// someone else's, so expensive interior tiles don't leave cores idle.
+// Tiles are dealt nearest-to-focus first, so the part of the image the user
+// is looking at (screen center or cursor) finishes first.
+class TileScheduler
+{
+public:
+    typedef std::function<void(const Tile& tile, int worker)> TileWork;
+
+    // 0 threads means one per hardware thread. The calling thread counts as
+    // worker 0 and works alongside the pool.
+    explicit TileScheduler(int threads = 0);
+    ~TileScheduler();
+
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    int workerCount() const { return (int)queues.size(); }
+
+    // Runs `work` over every tile of a width x height image and returns once
+    // all of them are done. (focus_x, focus_y) is in pixels. Concurrent calls
+    // from different threads take turns.
+    void run(int width, int height, int tile_size, double focus_x, double focus_y, const TileWork& work);
+
+    // Same, for an explicit list of tiles, dealt in the given order
+    void run(const std::vector<Tile>& tiles, const TileWork& work);
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+
+    void workerLoop(int worker);
+    void drain(int worker);
+    bool takeTile(int worker, Tile& tile);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    unsigned generation = 0;
+    bool stopping = false;
+    const TileWork* current_work = nullptr;
+    std::atomic<int> remaining;
+    int busy_workers = 0;
+};
+
+#endif
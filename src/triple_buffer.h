@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free hand-off of whole frames from one producer thread to one
+// consumer. Each side owns a slot outright and the third sits between them;
+// publishing and picking up swap a side's slot with the middle one in a
+// single atomic exchange, so neither side ever waits for the other and a
+// frame is never written while it's being read.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side: the slot to fill next
+    T& back() { return slots[back_index]; }
+
+    // Producer side: hands the filled back() to the consumer, replacing any
+    // frame it hasn't picked up yet
+    void publish()
+    {
+        back_index = middle.exchange(back_index | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer side: moves the newest published frame into front(). Returns
+    // false, leaving front() alone, if nothing was published since.
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front_index = middle.exchange(front_index, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const { return slots[front_index]; }
+
+private:
+    static constexpr unsigned INDEX_MASK = 3;
+    static constexpr unsigned FRESH = 4;
+
+    T slots[3];
+    std::atomic<unsigned> middle{1};
+    unsigned back_index = 0;
+    unsigned front_index = 2;
+};
+
+#endif
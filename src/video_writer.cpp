@@ -0,0 +1,118 @@
+#include "video_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <vector>
+
+#include "image_writer.h"
+
+namespace
+{
+
+class Y4mWriter : public VideoWriter
+{
+public:
+    Y4mWriter(FILE* file, int width, int height, int fps)
+        : file(file), width(width), height(height), planes((size_t)width * height * 3)
+    {
+        ok = std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps) > 0;
+    }
+
+    ~Y4mWriter() override
+    {
+        if (file && file != stdout)
+            std::fclose(file);
+    }
+
+    bool writeFrame(const uint8_t* rgb) override
+    {
+        size_t pixels = (size_t)width * height;
+        uint8_t* y_plane = planes.data();
+        uint8_t* u_plane = y_plane + pixels;
+        uint8_t* v_plane = u_plane + pixels;
+        for (size_t i = 0; i < pixels; i++)
+        {
+            double r = rgb[3 * i], g = rgb[3 * i + 1], b = rgb[3 * i + 2];
+            y_plane[i] = (uint8_t)(16.0 + (65.481 * r + 128.553 * g + 24.966 * b) / 255.0 + 0.5);
+            u_plane[i] = (uint8_t)(128.0 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255.0 + 0.5);
+            v_plane[i] = (uint8_t)(128.0 + (112.0 * r - 93.786 * g - 18.214 * b) / 255.0 + 0.5);
+        }
+        ok = ok && std::fputs("FRAME\n", file) >= 0
+            && std::fwrite(planes.data(), 1, planes.size(), file) == planes.size();
+        return ok;
+    }
+
+    bool finish() override
+    {
+        ok = (file == stdout ? std::fflush(file) : std::fclose(file)) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* file;
+    int width, height;
+    std::vector<uint8_t> planes;
+    bool ok;
+};
+
+class NumberedImageWriter : public VideoWriter
+{
+public:
+    NumberedImageWriter(const std::string& pattern, int width, int height)
+        : pattern(pattern), width(width), height(height)
+    {
+    }
+
+    bool writeFrame(const uint8_t* rgb) override
+    {
+        char path[4096];
+        std::snprintf(path, sizeof(path), pattern.c_str(), frame++);
+        std::unique_ptr<ImageWriter> writer = openImageWriter(path, width, height);
+        return writer && writer->writeRows(rgb, height) && writer->finish();
+    }
+
+    bool finish() override { return true; }
+
+private:
+    std::string pattern;
+    int width, height;
+    int frame = 0;
+};
+
+// Exactly one conversion, and it's %d with optional zero padding and width
+bool isFramePattern(const std::string& path)
+{
+    int conversions = 0;
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        if (path[i] != '%')
+            continue;
+        size_t j = i + 1;
+        while (j < path.size() && std::isdigit((unsigned char)path[j]))
+            j++;
+        if (j == path.size() || path[j] != 'd')
+            return false;
+        conversions++;
+        i = j;
+    }
+    return conversions == 1;
+}
+
+}
+
+std::unique_ptr<VideoWriter> openVideoWriter(const std::string& path, int width, int height, int fps)
+{
+    if (isFramePattern(path))
+        return std::unique_ptr<VideoWriter>(new NumberedImageWriter(path, width, height));
+
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+    if (path != "-" && extension != ".y4m")
+        return nullptr;
+    FILE* file = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    if (!file)
+        return nullptr;
+    return std::unique_ptr<VideoWriter>(new Y4mWriter(file, width, height, fps));
+}
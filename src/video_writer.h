@@ -0,0 +1,27 @@
+#ifndef VIDEO_WRITER_H
+#define VIDEO_WRITER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Takes a video a frame at a time, each frame 8-bit RGB rows top row first
+class VideoWriter
+{
+public:
+    virtual ~VideoWriter() {}
+
+    virtual bool writeFrame(const uint8_t* rgb) = 0;
+
+    // Flushes and closes; false if anything failed along the way
+    virtual bool finish() = 0;
+};
+
+// "-" (stdout) or a .y4m path is a raw YUV4MPEG2 stream, 4:4:4 in BT.601
+// studio range, which ffmpeg and most encoders take as is. A path with one
+// printf integer conversion, such as "frame%05d.png", is numbered images in
+// whatever format the extension names. nullptr for any other path or a
+// file that can't be created.
+std::unique_ptr<VideoWriter> openVideoWriter(const std::string& path, int width, int height, int fps);
+
+#endif
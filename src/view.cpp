@@ -0,0 +1,75 @@
+#include "view.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "mp_real.h"
+
+namespace
+{
+
+struct CenterOffset
+{
+    View& view;
+    const floatexp& dx;
+    const floatexp& dy;
+
+    template <int N>
+    void run() const
+    {
+        MpReal<N> x = MpReal<N>::fromString(view.center_x) + MpReal<N>::fromScaled(dx.mantissa, dx.exponent);
+        MpReal<N> y = MpReal<N>::fromString(view.center_y) + MpReal<N>::fromScaled(dy.mantissa, dy.exponent);
+        view.center_x = x.toString(view.centerDigits());
+        view.center_y = y.toString(view.centerDigits());
+    }
+};
+
+}
+
+floatexp View::pixelSpacing() const
+{
+    return zoom / floatexp((double)std::max(1, std::max(width, height)));
+}
+
+int View::precisionBits() const
+{
+    return std::max(64, -pixelSpacing().exponent + 64);
+}
+
+int View::centerDigits() const
+{
+    return std::max(17, (int)(-pixelSpacing().log2() * 0.30103) + 6);
+}
+
+double View::centerX() const
+{
+    return std::strtod(center_x.c_str(), nullptr);
+}
+
+double View::centerY() const
+{
+    return std::strtod(center_y.c_str(), nullptr);
+}
+
+void View::offsetCenter(const floatexp& dx, const floatexp& dy)
+{
+    CenterOffset offset = { *this, dx, dy };
+    withPrecision(precisionBits(), offset);
+}
+
+floatexp View::pixelOffsetX(int x) const
+{
+    return floatexp((x + 0.5) / width - 0.5) * zoom;
+}
+
+floatexp View::pixelOffsetY(int y) const
+{
+    return floatexp((y + 0.5) / height - 0.5) * zoom;
+}
+
+bool View::operator==(const View& other) const
+{
+    return fractal == other.fractal && center_x == other.center_x && center_y == other.center_y
+        && zoom.mantissa == other.zoom.mantissa && zoom.exponent == other.zoom.exponent
+        && width == other.width && height == other.height && max_iterations == other.max_iterations;
+}
@@ -0,0 +1,45 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <string>
+
+#include "floatexp.h"
+#include "fractals.h"
+
+// Everything an engine needs to know to render one frame. The center is kept
+// as decimal text so it can carry as many digits as the zoom needs; `zoom` is
+// the extent of the view along each axis (the shader's u_zoom).
+struct View
+{
+    Fractal fractal = Fractal::MANDELBROT;
+    std::string center_x = "0";
+    std::string center_y = "0";
+    floatexp zoom = floatexp(2.0);
+    int width = 0;
+    int height = 0;
+    int max_iterations = 10000;
+
+    floatexp pixelSpacing() const;
+
+    // Fraction bits needed to tell neighbouring pixels apart, with guard bits
+    int precisionBits() const;
+
+    // Decimal digits of the center worth keeping at this zoom
+    int centerDigits() const;
+
+    double centerX() const;
+    double centerY() const;
+
+    // Moves the center by an offset in the complex plane
+    void offsetCenter(const floatexp& dx, const floatexp& dy);
+
+    // Offset of pixel (x, y) from the center, matching the shader's
+    // (gl_FragCoord.xy / u_resolution - 0.5) * u_zoom with row 0 at the bottom
+    floatexp pixelOffsetX(int x) const;
+    floatexp pixelOffsetY(int y) const;
+
+    bool operator==(const View& other) const;
+    bool operator!=(const View& other) const { return !(*this == other); }
+};
+
+#endif
@@ -0,0 +1,328 @@
+#include "zoom_video.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "formula_kernels.h"
+#include "image_writer.h"
+#include "perturbation.h"
+#include "perturbation_engine.h"
+#include "simd_kernels.h"
+#include "tile_scheduler.h"
+
+namespace
+{
+
+const double PI = 3.14159265358979323846;
+// Just past the corners' distance from the center, in units of the zoom
+const double CORNER_RADIUS = 0.7072;
+
+// Evenly spaced in log2 zoom from the start to the end
+struct ZoomPath
+{
+    double start_log2, end_log2;
+    int frames;
+
+    floatexp zoomAt(int frame) const
+    {
+        double t = frames > 1 ? (double)frame / (frames - 1) : 1.0;
+        return floatexp::fromLog2(start_log2 + t * (end_log2 - start_log2));
+    }
+};
+
+ZoomPath zoomPath(const View& view, const ZoomVideoOptions& options)
+{
+    ZoomPath path;
+    path.start_log2 = options.start_zoom.log2();
+    path.end_log2 = view.zoom.log2();
+    path.frames = options.frames;
+    if (path.frames <= 0)
+        path.frames = std::max(2, (int)std::lround(std::fabs(path.start_log2 - path.end_log2) * 30.0) + 1);
+    return path;
+}
+
+bool renderFrames(const View& view, const ZoomVideoOptions& options, VideoWriter& writer, ZoomVideoStats& stats)
+{
+    ZoomPath path = zoomPath(view, options);
+    auto scheduler = std::make_shared<TileScheduler>();
+    CpuEngine cpu_engine(scheduler);
+    cpu_engine.fill = options.fill;
+    cpu_engine.interior = options.interior;
+    PerturbationEngine perturbation_engine(scheduler);
+
+    IterationBuffer buffer;
+    std::vector<uint8_t> rgb;
+    for (int frame = 0; frame < path.frames; frame++)
+    {
+        View frame_view = view;
+        frame_view.zoom = path.zoomAt(frame);
+        bool rendered;
+        if (view.fractal != Fractal::MANDELBROT || doubleResolvesView(frame_view))
+            rendered = cpu_engine.render(frame_view, buffer);
+        else
+        {
+            PrimaryReference& shared = perturbation_engine.options.reference;
+            if (!shared.orbit)
+            {
+                shared = findPrimaryReference(view.center_x, view.center_y, view.zoom, view.width, view.height,
+                                              view.max_iterations, perturbation_engine.options);
+                stats.references++;
+            }
+            rendered = perturbation_engine.render(frame_view, buffer);
+            stats.references += perturbation_engine.lastStats().references - 1;
+        }
+        if (!rendered)
+            return false;
+        stats.points += (double)view.width * view.height;
+
+        grayscaleRows(buffer, view.max_iterations, view.height - 1, view.height, rgb);
+        if (!writer.writeFrame(rgb.data()))
+            return false;
+        stats.frames++;
+    }
+    return writer.finish();
+}
+
+// Points on rings around the center: ring `row` of the map has radius
+// radius0 * 2^-((row + 0.5) / rows_per_octave) and `width` samples
+struct ExponentialMap
+{
+    floatexp radius0;
+    int width;
+    int rows_per_octave;
+    std::vector<double> cosine, sine;
+
+    ExponentialMap(const floatexp& radius0, int width)
+        : radius0(radius0), width(width), cosine(width), sine(width)
+    {
+        // Square cells: the ring spacing in log radius matches the angle
+        // between samples
+        rows_per_octave = std::max(1, (int)std::lround(width * std::log(2.0) / (2.0 * PI)));
+        for (int i = 0; i < width; i++)
+        {
+            double angle = 2.0 * PI * (i + 0.5) / width;
+            cosine[i] = std::cos(angle);
+            sine[i] = std::sin(angle);
+        }
+    }
+
+    floatexp radius(int row) const
+    {
+        return radius0 * floatexp::fromLog2(-(row + 0.5) / rows_per_octave);
+    }
+
+    // Fractional ring holding points `log2_radius` from the center
+    double rowAt(double log2_radius) const
+    {
+        return (radius0.log2() - log2_radius) * rows_per_octave - 0.5;
+    }
+};
+
+// One octave's strip of the map through the perturbation renderer, on an
+// MpReal wide enough for its innermost ring
+struct OctaveRender
+{
+    const View& view;
+    const ExponentialMap& map;
+    int first_row;
+    const PerturbationOptions& options;
+    std::vector<int>& iterations;
+
+    template <int N>
+    PerturbationStats run() const
+    {
+        int rows = map.rows_per_octave;
+        std::vector<floatexp> radii(rows);
+        for (int j = 0; j < rows; j++)
+            radii[j] = map.radius(first_row + j);
+        auto offsets = [&](size_t index, floatexp& x, floatexp& y)
+        {
+            const floatexp& radius = radii[index / map.width];
+            x = radius * floatexp(map.cosine[index % map.width]);
+            y = radius * floatexp(map.sine[index % map.width]);
+        };
+
+        // Rings wrap around in angle
+        size_t count = (size_t)map.width * rows;
+        auto neighbours = [&](size_t index, const auto& visit)
+        {
+            size_t ring = index - index % map.width;
+            visit(ring + (index - ring + 1) % map.width);
+            visit(ring + (index - ring + map.width - 1) % map.width);
+            if (index >= (size_t)map.width)
+                visit(index - map.width);
+            if (index + map.width < count)
+                visit(index + map.width);
+        };
+
+        MpReal<N> center_x = MpReal<N>::fromString(view.center_x), center_y = MpReal<N>::fromString(view.center_y);
+        if (needsFloatExp(spacing()))
+            return renderPerturbationPoints<floatexp>(center_x, center_y, count, offsets, view.max_iterations, options,
+                                                      iterations, floatexp(), floatexp(), neighbours);
+        return renderPerturbationPoints<double>(center_x, center_y, count, offsets, view.max_iterations, options,
+                                                iterations, floatexp(), floatexp(), neighbours);
+    }
+
+    floatexp spacing() const
+    {
+        return map.radius(first_row + map.rows_per_octave - 1) * floatexp(2.0 * PI / map.width);
+    }
+};
+
+// An octave double resolves, straight through the formula kernels with
+// interior checks, on the tile pool
+void renderOctaveDirect(const View& view, const ExponentialMap& map, int first_row, FormulaSpanKernel<double> kernel,
+                        TileScheduler& scheduler, std::vector<int>& iterations)
+{
+    double center_x = view.centerX(), center_y = view.centerY();
+    iterations.resize((size_t)map.width * map.rows_per_octave);
+    scheduler.run(map.width, map.rows_per_octave, 64, -1.0, -1.0, [&](const Tile& tile, int)
+    {
+        std::vector<double> cx(tile.width), cy(tile.width);
+        for (int j = tile.y; j < tile.y + tile.height; j++)
+        {
+            double radius = map.radius(first_row + j).toDouble();
+            for (int i = 0; i < tile.width; i++)
+            {
+                cx[i] = center_x + radius * map.cosine[tile.x + i];
+                cy[i] = center_y + radius * map.sine[tile.x + i];
+            }
+            kernel(cx.data(), cy.data(), tile.width, view.max_iterations, &iterations[(size_t)j * map.width + tile.x]);
+        }
+    });
+}
+
+bool renderExponentialMap(const View& view, const ZoomVideoOptions& options, VideoWriter& writer,
+                          ZoomVideoStats& stats)
+{
+    // The same kernels the CPU engine picks
+    FormulaSpanKernel<double> kernel = view.fractal == Fractal::MANDELBROT
+        ? doubleSpanKernel(detectSimdLevel(), options.interior)
+        : formulaSpanKernel<double>(view.fractal, options.interior);
+    // The map grows outward from start_zoom, so it only zooms in
+    if (!kernel || options.start_zoom.log2() < view.zoom.log2())
+        return false;
+    TileScheduler scheduler;
+
+    ZoomPath path = zoomPath(view, options);
+    int size = std::max(view.width, view.height);
+    int map_width = options.map_width > 0 ? options.map_width : (int)std::ceil(2.0 * PI * CORNER_RADIUS * size);
+    ExponentialMap map(options.start_zoom * floatexp(CORNER_RADIUS), map_width);
+    int rows_per_octave = map.rows_per_octave;
+
+    // Each pixel's ring and angle for a zoom of 1; a frame of zoom Z just
+    // moves every pixel log2(Z) octaves in
+    size_t pixels = (size_t)view.width * view.height;
+    std::vector<float> pixel_row(pixels), pixel_column(pixels);
+    // The center pixel of an odd by odd frame sits on the center itself;
+    // it and anything closer than a quarter pixel take the ring there
+    double min_radius_squared = 0.0625 / ((double)size * size);
+    double innermost = 0.0;
+    for (int y = 0; y < view.height; y++)
+    {
+        double v = (y + 0.5) / view.height - 0.5;
+        for (int x = 0; x < view.width; x++)
+        {
+            double u = (x + 0.5) / view.width - 0.5;
+            double angle = std::atan2(v, u);
+            if (angle < 0.0)
+                angle += 2.0 * PI;
+            size_t index = (size_t)y * view.width + x;
+            double log_radius = 0.5 * std::log2(std::max(u * u + v * v, min_radius_squared));
+            innermost = std::min(innermost, log_radius);
+            pixel_row[index] = (float)map.rowAt(log_radius);
+            pixel_column[index] = (float)(angle / (2.0 * PI) * map_width - 0.5);
+        }
+    }
+    // A frame needs the rings from its corners to its innermost pixel center
+    auto firstRow = [&](int frame) { return (int)std::floor(map.rowAt(path.zoomAt(frame).log2() + std::log2(CORNER_RADIUS))); };
+    auto lastRow = [&](int frame) { return (int)std::ceil(map.rowAt(path.zoomAt(frame).log2() + innermost)) + 1; };
+    int total_rows = lastRow(path.frames - 1) + 1;
+    int octaves = (total_rows + rows_per_octave - 1) / rows_per_octave;
+
+    PerturbationOptions perturbation_options;
+    perturbation_options.scheduler = &scheduler;
+
+    std::vector<std::vector<int>> strips(octaves);
+    auto count = [&](int row, int column)
+    {
+        row = std::min(std::max(row, 0), total_rows - 1);
+        column = (column % map_width + map_width) % map_width;
+        return (float)strips[row / rows_per_octave][(size_t)(row % rows_per_octave) * map_width + column];
+    };
+
+    std::vector<uint8_t> rgb(pixels * 3);
+    int frame = 0;
+    for (int octave = 0; octave < octaves && frame < path.frames; octave++)
+    {
+        OctaveRender render = { view, map, octave * rows_per_octave, perturbation_options, strips[octave] };
+        View ring_view = view;
+        ring_view.width = ring_view.height = 1;
+        ring_view.zoom = render.spacing();
+        if (doubleResolvesView(ring_view))
+            renderOctaveDirect(view, map, octave * rows_per_octave, kernel, scheduler, strips[octave]);
+        else if (view.fractal != Fractal::MANDELBROT)
+            return false;
+        else
+        {
+            PrimaryReference& shared = perturbation_options.reference;
+            if (!shared.orbit)
+            {
+                shared = findPrimaryReference(view.center_x, view.center_y, view.zoom, view.width, view.height,
+                                              view.max_iterations, perturbation_options);
+                stats.references++;
+            }
+            PerturbationStats octave_stats = withPrecision(referencePrecisionBits(render.spacing()), render);
+            stats.references += octave_stats.references - 1;
+        }
+        stats.points += (double)map_width * rows_per_octave;
+
+        // Every frame whose rings are all in now
+        int rows_ready = (octave + 1) * rows_per_octave;
+        for (; frame < path.frames && (lastRow(frame) < rows_ready || octave == octaves - 1); frame++)
+        {
+            double shift = (double)map.rowAt(path.zoomAt(frame).log2()) - map.rowAt(0.0);
+            float scale = 255.0f / view.max_iterations;
+            uint8_t* out = rgb.data();
+            for (int y = view.height - 1; y >= 0; y--)
+            {
+                for (int x = 0; x < view.width; x++)
+                {
+                    size_t index = (size_t)y * view.width + x;
+                    double row = pixel_row[index] + shift, column = pixel_column[index];
+                    int row0 = (int)std::floor(row), column0 = (int)std::floor(column);
+                    float row_t = (float)(row - row0), column_t = (float)(column - column0);
+                    float top = count(row0, column0) * (1.0f - column_t) + count(row0, column0 + 1) * column_t;
+                    float bottom = count(row0 + 1, column0) * (1.0f - column_t) + count(row0 + 1, column0 + 1) * column_t;
+                    uint8_t value = (uint8_t)(scale * (top * (1.0f - row_t) + bottom * row_t) + 0.5f);
+                    *out++ = value;
+                    *out++ = value;
+                    *out++ = value;
+                }
+            }
+            if (!writer.writeFrame(rgb.data()))
+                return false;
+            stats.frames++;
+        }
+
+        // Strips above everything the remaining frames show are done with
+        if (frame < path.frames)
+            for (int old = 0; old < octaves && (old + 1) * rows_per_octave <= firstRow(frame); old++)
+                std::vector<int>().swap(strips[old]);
+    }
+    return writer.finish();
+}
+
+}
+
+bool renderZoomVideo(const View& view, const ZoomVideoOptions& options, VideoWriter& writer, ZoomVideoStats* stats)
+{
+    ZoomVideoStats local_stats;
+    ZoomVideoStats& result = stats ? *stats : local_stats;
+    result = ZoomVideoStats();
+    if (options.mode == ZoomVideoMode::EXPONENTIAL_MAP)
+        return renderExponentialMap(view, options, writer, result);
+    return renderFrames(view, options, writer, result);
+}
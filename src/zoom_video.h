@@ -0,0 +1,56 @@
+#ifndef ZOOM_VIDEO_H
+#define ZOOM_VIDEO_H
+
+#include <unordered_map>
+
+#include "cpu_engine.h"
+#include "floatexp.h"
+#include "video_writer.h"
+#include "view.h"
+
+enum class ZoomVideoMode
+{
+    FRAMES,         // every frame rendered on its own, sharing one reference orbit
+    EXPONENTIAL_MAP // log-polar strips rendered once, frames warped from them
+};
+
+const std::unordered_map<ZoomVideoMode, const char*> ZOOM_VIDEO_MODES = {
+    {ZoomVideoMode::FRAMES, "Frames"},
+    {ZoomVideoMode::EXPONENTIAL_MAP, "Exponential map"}
+};
+
+struct ZoomVideoOptions
+{
+    ZoomVideoMode mode = ZoomVideoMode::FRAMES;
+    floatexp start_zoom = floatexp(2.0); // the first frame's; the view's zoom is the last's
+    int frames = 0;                      // 0 means 30 per octave of zoom
+    int map_width = 0;                   // samples around each ring of the map; 0 matches the frame corners
+    TileFill fill = TileFill::FULL;      // for frames the CPU engine renders
+    InteriorChecks interior;
+};
+
+struct ZoomVideoStats
+{
+    int frames = 0;
+    int references = 0;   // orbits iterated, the shared primary included
+    double points = 0.0;  // pixels or map samples iterated
+};
+
+// Renders a zoom into the view's center, from options.start_zoom down to
+// view.zoom with frames evenly spaced in log zoom, and hands the frames to
+// `writer` in order. Every deep frame reuses one primary reference orbit,
+// placed for the last and deepest frame, so the expensive orbit is iterated
+// once per video rather than once per frame.
+//
+// FRAMES renders each frame: the CPU engine while double resolves it, the
+// perturbation engine past that. EXPONENTIAL_MAP samples the plane on rings
+// around the center, log-spaced in radius, one octave of radius per strip,
+// and warps each frame out of the strips covering it; a whole video then
+// costs about as many points as a few dozen frames, at the price of
+// interpolated pixels. Only the strips frames still need are kept; the map
+// only zooms in, so start_zoom can't be smaller than view.zoom. Either way,
+// zooms past double are Mandelbrot only.
+bool renderZoomVideo(const View& view, const ZoomVideoOptions& options, VideoWriter& writer,
+                     ZoomVideoStats* stats = nullptr);
+
+#endif
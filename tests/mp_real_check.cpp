@@ -0,0 +1,109 @@
+// Self-check for the limb arithmetic behind MpReal: Karatsuba products must
+// equal the schoolbook ones exactly, and products that skip the low partial
+// products must stay within their error bound of the exact product. MpReal
+// multiplies below KARATSUBA_THRESHOLD limbs with the truncated schoolbook
+// products and from there on with full Karatsuba ones, so sizes from both
+// ranges are checked.
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "mp_real.h"
+
+namespace
+{
+
+const int SIZES[] = { 2, 4, 8, 16, 23, 32, 64, 128 };
+const int TRIALS = 200;
+
+int failures = 0;
+
+void check(bool ok, const char* what, int n, int trial)
+{
+    if (ok)
+        return;
+    std::printf("FAIL: %s at %d limbs, trial %d\n", what, n, trial);
+    failures++;
+}
+
+// Random limbs, with runs of all-zero and all-one limbs now and then, which
+// are where the carries and the signs of the Karatsuba differences go wrong
+void randomLimbs(std::mt19937_64& rng, std::vector<mp::Limb>& limbs)
+{
+    for (mp::Limb& limb : limbs)
+    {
+        switch (rng() % 8)
+        {
+            case 0:
+                limb = 0;
+                break;
+            case 1:
+                limb = ~(mp::Limb)0;
+                break;
+            default:
+                limb = rng();
+        }
+    }
+}
+
+// exact - truncated over the limbs a fixed point product keeps, [n - 1, 2n),
+// in units of limb n - 1; -1 if truncated came out above exact
+mp::Wide keptError(const std::vector<mp::Limb>& exact, const std::vector<mp::Limb>& truncated, int n)
+{
+    std::vector<mp::Limb> difference(2 * n);
+    if (mp::sub(difference.data(), exact.data(), truncated.data(), 2 * n) != 0)
+        return (mp::Wide)-1;
+    for (int i = n + 1; i < 2 * n; i++)
+        if (difference[i] != 0)
+            return (mp::Wide)-1;
+    bool below = false;
+    for (int i = 0; i < n - 1; i++)
+        below = below || difference[i] != 0;
+    return ((mp::Wide)difference[n] << 64 | difference[n - 1]) + (below ? 1 : 0);
+}
+
+void checkSize(std::mt19937_64& rng, int n)
+{
+    std::vector<mp::Limb> a(n), b(n), basecase(2 * n), karatsuba(2 * n), truncated(2 * n);
+    std::vector<mp::Limb> scratch(mp::karatsubaScratch(n) + 1);
+    // Skipping everything below limb n - 2 drops fewer than n partial
+    // products into each of the limbs below it, so less than n ulps in all
+    const mp::Wide bound = n;
+
+    for (int trial = 0; trial < TRIALS; trial++)
+    {
+        randomLimbs(rng, a);
+        randomLimbs(rng, b);
+
+        mp::mulBasecase(basecase.data(), a.data(), b.data(), n);
+        mp::mulKaratsuba(karatsuba.data(), a.data(), b.data(), n, scratch.data());
+        check(basecase == karatsuba, "Karatsuba product", n, trial);
+
+        mp::mulBasecase(truncated.data(), a.data(), b.data(), n, n - 2);
+        check(keptError(basecase, truncated, n) < bound, "truncated product error", n, trial);
+
+        mp::mulBasecase(basecase.data(), a.data(), a.data(), n);
+        mp::sqrKaratsuba(karatsuba.data(), a.data(), n, scratch.data());
+        check(basecase == karatsuba, "Karatsuba square", n, trial);
+
+        mp::sqrBasecase(truncated.data(), a.data(), n);
+        check(basecase == truncated, "schoolbook square", n, trial);
+
+        mp::sqrBasecase(truncated.data(), a.data(), n, n - 2);
+        check(keptError(basecase, truncated, n) < bound, "truncated square error", n, trial);
+    }
+}
+
+}
+
+int main()
+{
+    std::mt19937_64 rng(20260419);
+    for (int n : SIZES)
+        checkSize(rng, n);
+    if (failures)
+        return 1;
+    std::printf("mp_real: all products agree\n");
+    return 0;
+}